@@ -0,0 +1,110 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+// Measures the overhead of spawning tasks and how well uneven work is balanced.
+// Usage: scheduler_bench [workers]
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "TaskScheduler.h"
+
+using namespace gui;
+using namespace std::chrono;
+
+static double ElapsedNs(steady_clock::time_point start) {
+    return duration_cast<nanoseconds>(steady_clock::now() - start).count();
+}
+
+// Work whose cost grows with n, which the compiler cannot remove
+static uint64_t Spin(size_t n) {
+    volatile uint64_t x = 0;
+    for (size_t i = 0; i < n; ++i) {
+        x = x + i * i;
+    }
+    return x;
+}
+
+static void BenchSpawn(CTaskScheduler &scheduler, size_t count) {
+    std::atomic<size_t> done(0);
+    auto start = steady_clock::now();
+    {
+        CTaskGroup group(scheduler);
+        for (size_t i = 0; i < count; ++i) {
+            group.Run([&]() { ++done; });
+        }
+        group.Wait();
+    }
+    auto ns = ElapsedNs(start);
+    printf("spawn      %8zu empty tasks  %8.1f ns/task\n", (size_t) done, ns / count);
+}
+
+static void BenchNested(CTaskScheduler &scheduler, size_t outer, size_t inner) {
+    std::atomic<size_t> done(0);
+    auto start = steady_clock::now();
+    {
+        CTaskGroup group(scheduler);
+        for (size_t i = 0; i < outer; ++i) {
+            group.Run([&]() {
+                CTaskGroup nested(scheduler);
+                for (size_t j = 0; j < inner; ++j) {
+                    nested.Run([&]() { ++done; });
+                }
+                nested.Wait();
+            });
+        }
+        group.Wait();
+    }
+    auto ns = ElapsedNs(start);
+    printf("nested     %8zu empty tasks  %8.1f ns/task\n", (size_t) done, ns / done);
+}
+
+// Item i costs i units, so that a static split of the range would be unbalanced
+static void BenchBalance(CTaskScheduler &scheduler, size_t items, size_t unit) {
+    auto start = steady_clock::now();
+    for (size_t i = 0; i < items; ++i) {
+        Spin(i * unit);
+    }
+    auto serial = ElapsedNs(start);
+
+    start = steady_clock::now();
+    scheduler.ParallelFor(0, items, 1, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            Spin(i * unit);
+        }
+    });
+    auto parallel = ElapsedNs(start);
+
+    auto speedup = serial / parallel;
+    printf("balance    %8zu uneven items  %8.2fx speedup, %5.1f%% efficiency\n", items, speedup,
+           100 * speedup / (scheduler.GetWorkerCount() + 1));
+}
+
+int main(int argc, char **argv) {
+    auto workers = argc > 1 ? atoi(argv[1]) : 0;
+    auto scheduler = CTaskScheduler::Create(workers);
+    printf("%u workers\n", scheduler->GetWorkerCount());
+
+    BenchSpawn(*scheduler.get(), 1000000);
+    BenchNested(*scheduler.get(), 1000, 1000);
+    BenchBalance(*scheduler.get(), 1000, 1000);
+    return 0;
+}
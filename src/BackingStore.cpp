@@ -0,0 +1,48 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+#include "BackingStore.h"
+
+namespace gui {
+
+std::atomic<size_t> CBackingStore::s_usedBytes(0);
+std::atomic<size_t> CBackingStore::s_limitBytes(64 * 1024 * 1024);
+std::atomic<unsigned> CBackingStore::s_limitGeneration(0);
+
+CBackingStore::~CBackingStore() {
+    s_usedBytes -= GetWidth() * GetHeight() * sizeof(uint32_t);
+}
+
+CBackingStorePtr CBackingStore::Create(int width, int height) {
+    // The memory is reserved before allocating, so that the limit holds
+    // when several stores are created at once
+    auto size = (size_t) width * height * sizeof(uint32_t);
+    auto used = s_usedBytes.load();
+    do {
+        if (used + size > s_limitBytes) {
+            return nullptr;
+        }
+    } while (!s_usedBytes.compare_exchange_weak(used, used + size));
+
+    auto fb = CFrameBuffer::Create(nullptr, width, height, width * sizeof(uint32_t));
+    return CBackingStorePtr(new CBackingStore(fb));
+}
+
+} // namespace gui
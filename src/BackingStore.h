@@ -0,0 +1,108 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+#ifndef __GUI_BACKINGSTORE_H__
+
+#define __GUI_BACKINGSTORE_H__
+
+#include <atomic>
+#include <memory>
+
+#include "Framebuffer.h"
+#include "Region.h"
+
+namespace gui {
+
+class CBackingStore;
+using CBackingStorePtr = std::shared_ptr<CBackingStore>;
+
+// Offscreen copy of the rendered contents of a window and its children.
+// The memory used by all backing stores together is capped.
+class CBackingStore {
+private:
+    static std::atomic<size_t> s_usedBytes;
+    static std::atomic<size_t> s_limitBytes;
+
+    // Changes with the limit, so that stores that were refused are asked for again
+    static std::atomic<unsigned> s_limitGeneration;
+
+    CFrameBufferPtr m_fb;
+
+    // Parts of the surface that must be rendered again, in window coordinates
+    CRegion m_damage;
+
+    CBackingStore(const CFrameBufferPtr &fb) : m_fb(fb), m_damage(fb->GetRect()) {
+    }
+
+public:
+    ~CBackingStore();
+
+    // Returns nullptr if the store would exceed the memory limit
+    static CBackingStorePtr Create(int width, int height);
+
+    static size_t GetUsedBytes() {
+        return s_usedBytes;
+    }
+
+    static size_t GetLimitBytes() {
+        return s_limitBytes;
+    }
+
+    static unsigned GetLimitGeneration() {
+        return s_limitGeneration;
+    }
+
+    // Stores that already exist are kept when the limit is lowered
+    static void SetLimitBytes(size_t bytes) {
+        s_limitBytes = bytes;
+        ++s_limitGeneration;
+    }
+
+    CFrameBuffer &GetFrameBuffer() const {
+        return *m_fb.get();
+    }
+
+    int GetWidth() const {
+        return m_fb->GetRect().Width();
+    }
+
+    int GetHeight() const {
+        return m_fb->GetRect().Height();
+    }
+
+    const CRegion &GetDamage() const {
+        return m_damage;
+    }
+
+    void AddDamage(const TRect &r) {
+        auto c = r;
+        if (m_fb->GetRect().ClipRect(c)) {
+            m_damage.Union(c);
+        }
+    }
+
+    void ClearDamage() {
+        m_damage.Clear();
+    }
+};
+
+} // namespace gui
+
+#endif
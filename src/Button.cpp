@@ -29,22 +29,41 @@ void CButton::Draw(IFrameBuffer &fb) const {
     auto rect = TRect(0, 0, width - 1, height - 1);
 
     if (m_pressed) {
-        fb.DrawRect(rect, RGB(0xC0, 0xC0, 0xC0));
-        fb.DrawEmptyRect(rect, 0);
-        fb.DrawEmptyRect(TRect(1, 1, width - 2, height - 2), RGB(0xC0, 0xC0, 0xC0));
-        fb.DrawEmptyRect(TRect(2, 2, width - 3, height - 3), RGB(0xA0, 0xA0, 0xA0));
+        TDrawCommand commands[] = {
+            // Also paints the light grey border inside the outer one
+            TDrawCommand::Fill(rect, RGB(0xC0, 0xC0, 0xC0)),
+
+            // Outer border
+            TDrawCommand::HLine(TPoint(0, 0), width, 0),
+            TDrawCommand::HLine(TPoint(0, height - 1), width, 0),
+            TDrawCommand::VLine(TPoint(0, 0), height, 0),
+            TDrawCommand::VLine(TPoint(width - 1, 0), height, 0),
+
+            // Inner border
+            TDrawCommand::HLine(TPoint(2, 2), width - 4, RGB(0xA0, 0xA0, 0xA0)),
+            TDrawCommand::HLine(TPoint(2, height - 3), width - 4, RGB(0xA0, 0xA0, 0xA0)),
+            TDrawCommand::VLine(TPoint(2, 2), height - 4, RGB(0xA0, 0xA0, 0xA0)),
+            TDrawCommand::VLine(TPoint(width - 3, 2), height - 4, RGB(0xA0, 0xA0, 0xA0)),
+        };
+
+        fb.Submit(commands, sizeof(commands) / sizeof(commands[0]));
     } else {
-        fb.DrawRect(rect, RGB(0xC0, 0xC0, 0xC0));
-        // Outer border
-        fb.DrawHLine(TPoint(0, 0), width - 1, RGB(255, 255, 255));
-        fb.DrawVLine(TPoint(0, 1), height - 2, RGB(255, 255, 255));
+        TDrawCommand commands[] = {
+            TDrawCommand::Fill(rect, RGB(0xC0, 0xC0, 0xC0)),
+
+            // Outer border
+            TDrawCommand::HLine(TPoint(0, 0), width - 1, RGB(255, 255, 255)),
+            TDrawCommand::VLine(TPoint(0, 1), height - 2, RGB(255, 255, 255)),
+
+            TDrawCommand::HLine(TPoint(0, height - 1), width, RGB(0, 0, 0)),
+            TDrawCommand::VLine(TPoint(width - 1, 0), height - 1, RGB(0, 0, 0)),
 
-        fb.DrawHLine(TPoint(0, height - 1), width, RGB(0, 0, 0));
-        fb.DrawVLine(TPoint(width - 1, 0), height - 1, RGB(0, 0, 0));
+            // Inner border
+            TDrawCommand::HLine(TPoint(1, height - 2), width - 2, RGB(128, 128, 128)),
+            TDrawCommand::VLine(TPoint(width - 2, 1), height - 3, RGB(128, 128, 128)),
+        };
 
-        // Inner border
-        fb.DrawHLine(TPoint(1, height - 2), width - 2, RGB(128, 128, 128));
-        fb.DrawVLine(TPoint(width - 2, 1), height - 3, RGB(128, 128, 128));
+        fb.Submit(commands, sizeof(commands) / sizeof(commands[0]));
     }
 }
 
@@ -232,24 +232,21 @@ bool CCPIFont::RenderString(IFrameBuffer &fb, TPoint pos, const std::string &fon
 
     auto &fi = it->second;
 
-    auto starty = pos.y;
+    // Each glyph is a 1bpp mask, submit the whole string as one batch
+    std::vector<TDrawCommand> commands;
+    commands.reserve(text.size());
 
-    for (int y = 0; y < it->second.Height; ++y) {
-        auto startx = pos.x;
-        for (uint8_t c : text) {
-            auto offset = fi.CharSize * c;
-            auto data = &fi.Bitmap[offset];
-
-            char line = data[y];
-            for (auto x = 0; x < fi.Width; ++x) {
-                if (line & (1 << (fi.Width - x - 1))) {
-                    fb.PutPixel(startx + x, starty + y, color);
-                }
-            }
-            startx += fi.Width;
-        }
+    auto pitch = (fi.Width + 7) / 8;
+    auto x = pos.x;
+    for (uint8_t c : text) {
+        auto glyph = &fi.Bitmap[fi.CharSize * c];
+        auto rect = TRect(x, pos.y, x + fi.Width - 1, pos.y + fi.Height - 1);
+        commands.push_back(TDrawCommand::Mask(rect, glyph, pitch, color));
+        x += fi.Width;
     }
 
+    fb.Submit(commands.data(), commands.size());
+
     return true;
 }
 
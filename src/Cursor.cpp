@@ -24,18 +24,9 @@
 
 namespace gui {
 
-// TODO: faster and/xor to framebuffer
-void CImageData::Draw(IFrameBuffer &fb, int _x, int _y) const {
-    auto i = 0;
-    for (auto y = 0; y < m_height; ++y) {
-        for (auto x = 0; x < m_width; ++x, ++i) {
-            auto am = m_and.get();
-            bool b = (am[i / 8] & (0x80 >> (i % 8))) == 0;
-            if (b) {
-                fb.PutPixel(x + _x, y + _y, m_pixels.get()[i]);
-            }
-        }
-    }
+void CImageData::Draw(IFrameBuffer &fb, int x, int y) const {
+    auto rect = TRect(x, y, x + m_width - 1, y + m_height - 1);
+    fb.DrawMask(rect, m_mask.get(), (m_width + 7) / 8, m_pixels.get(), m_width);
 }
 
 CImageDataPtr CCursor::ParseImageWithPalette(const CURSORDIRENTRY *cde, const BITMAPINFOHEADER *bih,
@@ -85,21 +76,22 @@ CImageDataPtr CCursor::ParseImageWithPalette(const CURSORDIRENTRY *cde, const BI
     }
 
     auto andMaskSize = (bih->biWidth * bih->biHeight + 7) / 8;
-    auto andMask2 = std::shared_ptr<uint8_t[]>(new uint8_t[andMaskSize]);
+    auto visibleMask = std::shared_ptr<uint8_t[]>(new uint8_t[andMaskSize]);
 
     // The masks are stored upside down in the file.
-    // We flip them for easier handling.
+    // We flip them for easier handling, and invert them so that
+    // set bits mark the visible pixels of the cursor.
     // TODO: handle odd number of lines / pixels?
     for (auto y = 0; y < bih->biHeight / 2; y++) {
         for (auto x = 0; x < bih->biWidth / 8; x++) {
             auto t1 = andMask[y * bih->biWidth / 8 + x];
             auto t2 = andMask[(bih->biHeight - y - 1) * bih->biWidth / 8 + x];
-            andMask2[y * bih->biWidth / 8 + x] = t2;
-            andMask2[(bih->biHeight - y - 1) * bih->biWidth / 8 + x] = t1;
+            visibleMask[y * bih->biWidth / 8 + x] = ~t2;
+            visibleMask[(bih->biHeight - y - 1) * bih->biWidth / 8 + x] = ~t1;
         }
     }
 
-    return CImageData::Create(bih->biWidth, bih->biHeight, cde->wXHotspot, cde->wYHotspot, bmp, andMask2);
+    return CImageData::Create(bih->biWidth, bih->biHeight, cde->wXHotspot, cde->wYHotspot, bmp, visibleMask);
 }
 
 bool CCursor::ParseImage(const CURSORDIRENTRY *cde) {
@@ -101,23 +101,24 @@ private:
     int m_xh, m_yh;
     std::shared_ptr<uint32_t[]> m_pixels;
 
+    // 1bpp mask of the visible pixels (the inverse of the AND mask)
     // TODO: encode the mask in the alpha component
-    std::shared_ptr<uint8_t[]> m_and;
+    std::shared_ptr<uint8_t[]> m_mask;
 
     CImageData(int width, int height, int xh, int yh, std::shared_ptr<uint32_t[]> pixels,
-               std::shared_ptr<uint8_t[]> andMask) {
+               std::shared_ptr<uint8_t[]> mask) {
         m_width = width;
         m_height = height;
         m_xh = xh;
         m_yh = yh;
         m_pixels = pixels;
-        m_and = andMask;
+        m_mask = mask;
     }
 
 public:
     static CImageDataPtr Create(int width, int height, int xh, int yh, std::shared_ptr<uint32_t[]> pixels,
-                                std::shared_ptr<uint8_t[]> andMask) {
-        return CImageDataPtr(new CImageData(width, height, xh, yh, pixels, andMask));
+                                std::shared_ptr<uint8_t[]> mask) {
+        return CImageDataPtr(new CImageData(width, height, xh, yh, pixels, mask));
     }
 
     void Draw(IFrameBuffer &fb, int x, int y) const;
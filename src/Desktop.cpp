@@ -0,0 +1,67 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+#include "Desktop.h"
+
+namespace gui {
+
+void CDesktop::OnChildMoved(CWindow &child, TRect oldRect) {
+    // Only the topmost window can be moved, as nothing covers its pixels
+    auto topmost = !m_children.empty() && m_children.back().get() == &child;
+    if (IsDirty() || !topmost || (m_movedWnd && m_movedWnd.get() != &child)) {
+        CWindow::OnChildMoved(child, oldRect);
+        return;
+    }
+
+    if (!m_movedWnd) {
+        m_movedWnd = child.shared_from_this();
+        m_moveOrigin = oldRect;
+    }
+}
+
+bool CDesktop::GetPendingMove(TRect &oldRect, TRect &newRect) {
+    auto wnd = m_movedWnd;
+    m_movedWnd = nullptr;
+
+    if (!wnd) {
+        return false;
+    }
+
+    // Repainting everything, or the window was hidden or covered by another one since it moved
+    if (IsDirty() || !wnd->Visible() || m_children.empty() || m_children.back() != wnd) {
+        CWindow::OnChildMoved(*wnd.get(), m_moveOrigin);
+        return false;
+    }
+
+    oldRect = m_moveOrigin.Translated(GetX(), GetY());
+    newRect = wnd->GetRect().Translated(GetX(), GetY());
+    return oldRect != newRect;
+}
+
+void CDesktop::MoveDamage(const TRect &oldRect, const TRect &newRect) {
+    auto moved = m_damage;
+    moved.Intersect(oldRect);
+    if (!moved.Empty()) {
+        moved.Translate(newRect.p0.x - oldRect.p0.x, newRect.p0.y - oldRect.p0.y);
+        m_damage.Union(moved);
+    }
+}
+
+} // namespace gui
@@ -0,0 +1,82 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+#ifndef __GUI_DESKTOP_H__
+
+#define __GUI_DESKTOP_H__
+
+#include "Region.h"
+#include "Window.h"
+
+namespace gui {
+
+class CDesktop;
+using CDesktopPtr = std::shared_ptr<CDesktop>;
+
+// The root window. It collects the screen areas that must be repainted,
+// and keeps track of the topmost window being moved so that the window
+// manager can move its pixels instead of redrawing it.
+class CDesktop : public CWindow {
+private:
+    CWindowPtr m_movedWnd;
+    TRect m_moveOrigin;
+    CRegion m_damage;
+
+protected:
+    virtual void OnChildMoved(CWindow &child, TRect oldRect);
+
+public:
+    virtual void AddDamage(const TRect &r) {
+        m_damage.Union(r);
+    }
+
+    CDesktop(const this_is_private &p, TRect rect) : CWindow(p, rect) {
+    }
+
+    static CDesktopPtr Create(TRect rect) {
+        return std::make_shared<CDesktop>(this_is_private{0}, rect);
+    }
+
+    // Returns the position of the moved window before and after the moves
+    // that happened since the last call, in desktop coordinates.
+    // Returns false if nothing can be moved, in which case the damage
+    // caused by the move is recorded.
+    bool GetPendingMove(TRect &oldRect, TRect &newRect);
+
+    bool HasPendingMove() const {
+        return m_movedWnd != nullptr;
+    }
+
+    const CRegion &GetDamage() const {
+        return m_damage;
+    }
+
+    // Called when a moved window was copied to its new position.
+    // The damage that was recorded within its old position moves along with it.
+    void MoveDamage(const TRect &oldRect, const TRect &newRect);
+
+    void ClearDamage() {
+        m_damage.Clear();
+    }
+};
+
+} // namespace gui
+
+#endif
@@ -0,0 +1,88 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+#include "DisplayList.h"
+
+namespace gui {
+
+void CDisplayList::Replay(CFrameBuffer &fb) const {
+    for (const auto &entry : m_entries) {
+        if (entry.count) {
+            fb.Submit(&m_commands[entry.first], entry.count);
+        } else {
+            fb.CopyPixels(entry.source ? *entry.source.get() : fb, entry.rect, entry.dest);
+        }
+    }
+}
+
+void CDisplayList::Draw(IFrameBuffer &fb) const {
+    for (const auto &entry : m_entries) {
+        assert(entry.count);
+        fb.Submit(&m_commands[entry.first], entry.count);
+    }
+}
+
+void CRecordingFrameBuffer::Record(const TDrawCommand &c) {
+    auto command = c;
+    if (!command.Clip(GetRect())) {
+        return;
+    }
+
+    if (command.type == TDrawCommand::COPY) {
+        auto image = command.image->weak_from_this().lock();
+        if (image && (m_list->m_images.empty() || m_list->m_images.back() != image)) {
+            m_list->m_images.push_back(image);
+        }
+    }
+
+    auto &entries = m_list->m_entries;
+    if (entries.empty() || !entries.back().count) {
+        CDisplayList::TEntry entry;
+        entry.first = m_list->m_commands.size();
+        entry.count = 0;
+        entries.push_back(entry);
+    }
+
+    m_list->m_commands.push_back(command);
+    ++entries.back().count;
+}
+
+void CRecordingFrameBuffer::CopyPixels(const CFrameBuffer &fb, TRect source, TPoint dest) {
+    CDisplayList::TEntry entry;
+    entry.first = 0;
+    entry.count = 0;
+    entry.rect = source;
+    entry.dest = dest;
+
+    if (&fb != this) {
+        entry.source = fb.GetCopy(entry.rect);
+        if (!entry.source) {
+            return;
+        }
+
+        entry.dest.x += entry.rect.p0.x - source.p0.x;
+        entry.dest.y += entry.rect.p0.y - source.p0.y;
+        entry.rect = entry.source->GetRect();
+    }
+
+    m_list->m_entries.push_back(entry);
+}
+
+} // namespace gui
@@ -0,0 +1,126 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+#ifndef __GUI_DISPLAYLIST_H__
+
+#define __GUI_DISPLAYLIST_H__
+
+#include <memory>
+#include <vector>
+
+#include "Framebuffer.h"
+
+namespace gui {
+
+class CDisplayList;
+using CDisplayListPtr = std::shared_ptr<CDisplayList>;
+
+// Drawing operations recorded by a CRecordingFrameBuffer, clipped to its
+// bounds, to be replayed later, possibly on another thread. Images that are copied are kept alive
+// by the list. Masks and the pixels of masked copies (font glyphs, cursors)
+// must outlive it.
+class CDisplayList {
+private:
+    friend class CRecordingFrameBuffer;
+
+    struct TEntry {
+        // count commands starting at first, or a raw copy of pixels if count is 0
+        size_t first, count;
+
+        // Raw copy of the source rectangle of source, or of the framebuffer
+        // the list is replayed into if source is null
+        CFrameBufferPtr source;
+        TRect rect;
+        TPoint dest;
+    };
+
+    std::vector<TDrawCommand> m_commands;
+    std::vector<TEntry> m_entries;
+    std::vector<std::shared_ptr<const CFrameBuffer>> m_images;
+
+public:
+    bool Empty() const {
+        return m_entries.empty();
+    }
+
+    void Replay(CFrameBuffer &fb) const;
+
+    // Submits the recorded commands to fb, which may translate and clip them.
+    // The list must not contain raw copies.
+    void Draw(IFrameBuffer &fb) const;
+};
+
+// Framebuffer that records what is drawn into it instead of drawing it
+class CRecordingFrameBuffer : public CFrameBuffer {
+private:
+    CDisplayListPtr m_list;
+
+    void Record(const TDrawCommand &c);
+
+public:
+    CRecordingFrameBuffer(int width, int height) : CFrameBuffer(width, height) {
+        m_list = std::make_shared<CDisplayList>();
+    }
+
+    // Returns what was recorded so far and starts a new list
+    CDisplayListPtr TakeDisplayList() {
+        auto ret = m_list;
+        m_list = std::make_shared<CDisplayList>();
+        return ret;
+    }
+
+    virtual void DrawRect(TRect r, uint32_t color) {
+        Record(TDrawCommand::Fill(r, color));
+    }
+
+    virtual void DrawHLine(TPoint p, int width, uint32_t color) {
+        Record(TDrawCommand::HLine(p, width, color));
+    }
+
+    virtual void DrawVLine(TPoint p, int height, uint32_t color) {
+        Record(TDrawCommand::VLine(p, height, color));
+    }
+
+    virtual void PutPixel(int x, int y, uint32_t color) {
+        Record(TDrawCommand::Pixel(x, y, color));
+    }
+
+    virtual void CopyRect(const CFrameBuffer &fb, TRect source, TRect dest) {
+        Record(TDrawCommand::Copy(fb, source, dest));
+    }
+
+    virtual void Submit(const TDrawCommand *commands, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            Record(commands[i]);
+        }
+    }
+
+    virtual void Rasterize(const TDrawCommand &c) {
+        Record(c);
+    }
+
+    // Pixels copied from another framebuffer are copied right away,
+    // as they may change before the list is replayed.
+    virtual void CopyPixels(const CFrameBuffer &fb, TRect source, TPoint dest);
+};
+
+} // namespace gui
+
+#endif
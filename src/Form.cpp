@@ -29,36 +29,39 @@ void CForm::Draw(IFrameBuffer &fb) const {
     int width = m_rect.Width();
     int height = m_rect.Height();
 
-    // Exterior border
-    fb.DrawHLine(TPoint(0, 0), width - 1, RGB(200, 208, 212));
-    fb.DrawVLine(TPoint(0, 1), height - 2, RGB(200, 208, 212));
+    TDrawCommand commands[] = {
+        // Exterior border
+        TDrawCommand::HLine(TPoint(0, 0), width - 1, RGB(200, 208, 212)),
+        TDrawCommand::VLine(TPoint(0, 1), height - 2, RGB(200, 208, 212)),
 
-    fb.DrawHLine(TPoint(0, height - 1), width, RGB(0, 0, 0));
-    fb.DrawVLine(TPoint(width - 1, 0), height - 1, RGB(0, 0, 0));
+        TDrawCommand::HLine(TPoint(0, height - 1), width, RGB(0, 0, 0)),
+        TDrawCommand::VLine(TPoint(width - 1, 0), height - 1, RGB(0, 0, 0)),
 
-    // Interior border white - dark-grey
-    fb.DrawHLine(TPoint(1, 1), width - 3, RGB(255, 255, 255));
-    fb.DrawVLine(TPoint(1, 2), height - 4, RGB(255, 255, 255));
+        // Interior border white - dark-grey
+        TDrawCommand::HLine(TPoint(1, 1), width - 3, RGB(255, 255, 255)),
+        TDrawCommand::VLine(TPoint(1, 2), height - 4, RGB(255, 255, 255)),
 
-    fb.DrawHLine(TPoint(1, height - 2), width - 2, RGB(128, 128, 128));
-    fb.DrawVLine(TPoint(width - 2, 1), height - 3, RGB(128, 128, 128));
+        TDrawCommand::HLine(TPoint(1, height - 2), width - 2, RGB(128, 128, 128)),
+        TDrawCommand::VLine(TPoint(width - 2, 1), height - 3, RGB(128, 128, 128)),
 
-    // Client border - light grey - thickness 2
-    fb.DrawHLine(TPoint(2, 2), width - 5, RGB(200, 208, 212));
-    fb.DrawVLine(TPoint(2, 3), height - 6, RGB(200, 208, 212));
+        // Client border - light grey - thickness 2
+        TDrawCommand::HLine(TPoint(2, 2), width - 5, RGB(200, 208, 212)),
+        TDrawCommand::VLine(TPoint(2, 3), height - 6, RGB(200, 208, 212)),
 
-    fb.DrawHLine(TPoint(2, height - 3), width - 4, RGB(200, 208, 212));
-    fb.DrawVLine(TPoint(width - 3, 2), height - 5, RGB(200, 208, 212));
+        TDrawCommand::HLine(TPoint(2, height - 3), width - 4, RGB(200, 208, 212)),
+        TDrawCommand::VLine(TPoint(width - 3, 2), height - 5, RGB(200, 208, 212)),
 
-    fb.DrawHLine(TPoint(3, 3), width - 7, RGB(200, 208, 212));
-    fb.DrawVLine(TPoint(3, 4), height - 8, RGB(200, 208, 212));
+        TDrawCommand::HLine(TPoint(3, 3), width - 7, RGB(200, 208, 212)),
+        TDrawCommand::VLine(TPoint(3, 4), height - 8, RGB(200, 208, 212)),
 
-    fb.DrawHLine(TPoint(3, height - 4), width - 6, RGB(200, 208, 212));
-    fb.DrawVLine(TPoint(width - 4, 2), height - 6, RGB(200, 208, 212));
+        TDrawCommand::HLine(TPoint(3, height - 4), width - 6, RGB(200, 208, 212)),
+        TDrawCommand::VLine(TPoint(width - 4, 2), height - 6, RGB(200, 208, 212)),
 
-    // Title bar
-    auto tb = GetTitleBarRect();
-    fb.DrawRect(tb, RGB(0, 0, 255));
+        // Title bar
+        TDrawCommand::Fill(GetTitleBarRect(), RGB(0, 0, 255)),
+    };
+
+    fb.Submit(commands, sizeof(commands) / sizeof(commands[0]));
 }
 
 bool CForm::OnMouseBeginDragHandler(const MouseState &state) {
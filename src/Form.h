@@ -113,6 +113,7 @@ public:
         lbl->SetText("X");
 
         m_resizable = true;
+        SetBackingStore(true);
 
         InterceptChildEvents(true);
     }
@@ -132,6 +133,16 @@ public:
 
     virtual void Draw(IFrameBuffer &fb) const;
 
+    // The borders and the title bar surround the client area
+    virtual bool IsOpaque() const {
+        return true;
+    }
+
+    // Forms that are too short for their title bar get it clipped
+    virtual bool DrawsInsideBounds() const {
+        return GetTitleBarRect().p1.y < GetHeight();
+    }
+
     virtual void SetRect(TRect r) {
         CWindow::SetRect(r);
         m_close->SetRect(GetCloseRect());
@@ -18,19 +18,146 @@
 /// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 /// SOFTWARE.
 
+#include <string.h>
+
 #include "Framebuffer.h"
+#include "PixelOps.h"
 
 namespace gui {
 
+// Number of commands that framebuffer wrappers transform at once
+static const size_t BatchSize = 64;
+
+bool TDrawCommand::Clip(const TRect &clip) {
+    if (!rect.Valid()) {
+        return false;
+    }
+
+    auto r = rect;
+    if (!clip.ClipRect(r)) {
+        return false;
+    }
+
+    // The source of a scaled copy is kept whole, the visible part
+    // is picked from the scaled image once it is rasterized.
+    if (type != FILL && !IsScaled()) {
+        source.p0.x += r.p0.x - rect.p0.x;
+        source.p0.y += r.p0.y - rect.p0.y;
+        source.p1.x += r.p1.x - rect.p1.x;
+        source.p1.y += r.p1.y - rect.p1.y;
+        target = r;
+    }
+
+    rect = r;
+    return true;
+}
+
+// Turns a scaled copy into a plain copy from the scaled image.
+// The returned pointer keeps the scaled image alive while it is copied.
+static CFrameBufferPtr ResolveScaledCopy(TDrawCommand &c) {
+    auto scaled = c.image->GetScaled(c.source, c.target.Width(), c.target.Height());
+    if (!scaled) {
+        return nullptr;
+    }
+
+    c.image = scaled.get();
+    c.source.p0.x = c.rect.p0.x - c.target.p0.x;
+    c.source.p0.y = c.rect.p0.y - c.target.p0.y;
+    c.source.p1.x = c.rect.p1.x - c.target.p0.x;
+    c.source.p1.y = c.rect.p1.y - c.target.p0.y;
+    c.target = c.rect;
+    return scaled;
+}
+
+void IFrameBuffer::Submit(const TDrawCommand *commands, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const auto &c = commands[i];
+        if (!c.rect.Valid()) {
+            continue;
+        }
+
+        switch (c.type) {
+            case TDrawCommand::FILL:
+                DrawRect(c.rect, c.color);
+                break;
+
+            case TDrawCommand::COPY:
+                if (c.IsScaled()) {
+                    auto copy = c;
+                    auto scaled = ResolveScaledCopy(copy);
+                    if (scaled) {
+                        CopyRect(*copy.image, copy.source, copy.rect);
+                    }
+                } else {
+                    CopyRect(*c.image, c.source, c.rect);
+                }
+                break;
+
+            case TDrawCommand::MASK: {
+                for (auto y = 0; y < c.rect.Height(); ++y) {
+                    auto sy = c.source.p0.y + y;
+                    auto row = c.mask + sy * c.maskPitch;
+                    for (auto x = 0; x < c.rect.Width(); ++x) {
+                        auto sx = c.source.p0.x + x;
+                        if (row[sx / 8] & (0x80 >> (sx % 8))) {
+                            auto color = c.pixels ? c.pixels[sy * c.pixelsPitch + sx] : c.color;
+                            PutPixel(c.rect.p0.x + x, c.rect.p0.y + y, color);
+                        }
+                    }
+                }
+            } break;
+        }
+    }
+}
+
 void IFrameBuffer::DrawEmptyRect(TRect r, uint32_t color) {
-    DrawHLine(r.p0, r.Width(), color);
-    DrawHLine(TPoint(r.p0.x, r.p1.y), r.Width(), color);
-    DrawVLine(r.p0, r.Height(), color);
-    DrawVLine(TPoint(r.p1.x, r.p0.y), r.Height(), color);
+    TDrawCommand commands[] = {
+        TDrawCommand::HLine(r.p0, r.Width(), color),
+        TDrawCommand::HLine(TPoint(r.p0.x, r.p1.y), r.Width(), color),
+        TDrawCommand::VLine(r.p0, r.Height(), color),
+        TDrawCommand::VLine(TPoint(r.p1.x, r.p0.y), r.Height(), color),
+    };
+    Submit(commands, sizeof(commands) / sizeof(commands[0]));
+}
+
+void CTranslatedFrameBuffer::Submit(const TDrawCommand *commands, size_t count) {
+    TDrawCommand batch[BatchSize];
+    while (count) {
+        auto n = count < BatchSize ? count : BatchSize;
+        for (size_t i = 0; i < n; ++i) {
+            batch[i] = commands[i];
+            batch[i].Translate(m_p);
+        }
+        m_base.Submit(batch, n);
+        commands += n;
+        count -= n;
+    }
+}
+
+void CClippedFrameBuffer::Submit(const TDrawCommand *commands, size_t count) {
+    TDrawCommand batch[BatchSize];
+    while (count) {
+        auto n = count < BatchSize ? count : BatchSize;
+        size_t visible = 0;
+        for (size_t i = 0; i < n; ++i) {
+            batch[visible] = commands[i];
+            if (batch[visible].Clip(m_rect)) {
+                ++visible;
+            }
+        }
+        if (visible) {
+            m_base.Submit(batch, visible);
+        }
+        commands += n;
+        count -= n;
+    }
 }
 
 CFrameBuffer::CFrameBuffer(uint32_t *pixels, int width, int height, uint32_t pitch)
     : CFrameBufferBase(TRect(TPoint(0, 0), TPoint(width - 1, height - 1))) {
+    m_alphaMode = ALPHA_STRAIGHT;
+    m_opacity = OPACITY_UNKNOWN;
+    m_scaleFilter = SCALE_BILINEAR;
     m_pitch = pitch / sizeof(*m_pixels);
     assert((pitch % sizeof(*m_pixels)) == 0);
     assert((int) m_pitch >= m_rect.Width());
@@ -44,22 +171,334 @@ CFrameBuffer::CFrameBuffer(uint32_t *pixels, int width, int height, uint32_t pit
     }
 }
 
-void CFrameBuffer::CopyRect(CFrameBufferPtr fb, TRect source, TRect dest) {
-    // TODO: support resizing
-    assert(source.Width() == dest.Width() && source.Height() == dest.Height());
+CFrameBuffer::CFrameBuffer(int width, int height) : CFrameBufferBase(TRect(TPoint(0, 0), TPoint(width - 1, height - 1))) {
+    m_alphaMode = ALPHA_STRAIGHT;
+    m_opacity = OPACITY_UNKNOWN;
+    m_scaleFilter = SCALE_BILINEAR;
+    m_pitch = width;
+    m_pixels = nullptr;
+    m_ownsPixels = false;
+}
+
+// Clips the destination rectangle to the bounds of this framebuffer
+// and the source rectangle to the bounds of the source framebuffer,
+// keeping both rectangles the same size.
+static bool ClipCopy(const TRect &destBounds, const TRect &sourceBounds, TRect &source, TRect &dest) {
+    auto cdest = dest;
+    if (!destBounds.ClipRect(cdest)) {
+        return false;
+    }
+
+    source.p0.x += cdest.p0.x - dest.p0.x;
+    source.p0.y += cdest.p0.y - dest.p0.y;
+    source.p1.x += cdest.p1.x - dest.p1.x;
+    source.p1.y += cdest.p1.y - dest.p1.y;
+    dest = cdest;
+
+    auto csource = source;
+    if (!sourceBounds.ClipRect(csource)) {
+        return false;
+    }
+
+    dest.p0.x += csource.p0.x - source.p0.x;
+    dest.p0.y += csource.p0.y - source.p0.y;
+    dest.p1.x += csource.p1.x - source.p1.x;
+    dest.p1.y += csource.p1.y - source.p1.y;
+    source = csource;
+
+    return true;
+}
+
+void CFrameBuffer::CopyRect(const CFrameBuffer &fb, TRect source, TRect dest) {
     assert(source.Valid() && dest.Valid());
 
-    // TODO: optimize this
+    if (source.Width() != dest.Width() || source.Height() != dest.Height()) {
+        auto scaled = fb.GetScaled(source, dest.Width(), dest.Height());
+        if (scaled) {
+            CopyRect(*scaled, scaled->GetRect(), dest);
+        }
+        return;
+    }
+
+    if (fb.m_opacity == OPACITY_TRANSPARENT) {
+        return;
+    }
+
+    if (!ClipCopy(m_rect, fb.m_rect, source, dest)) {
+        return;
+    }
+
+    Invalidate();
+
+    auto w = source.Width();
+    auto h = source.Height();
+    auto sp = &fb.m_pixels[source.p0.y * fb.m_pitch + source.p0.x];
+    auto dp = &m_pixels[dest.p0.y * m_pitch + dest.p0.x];
+
+    if (fb.m_opacity == OPACITY_OPAQUE) {
+        for (auto y = 0; y < h; ++y, sp += fb.m_pitch, dp += m_pitch) {
+            memcpy(dp, sp, w * sizeof(*dp));
+        }
+        return;
+    }
+
+    auto blend = fb.m_alphaMode == ALPHA_PREMULTIPLIED ? pixels::BlendRowPremultiplied : pixels::BlendRow;
+
+    if (fb.m_opacity == OPACITY_UNKNOWN) {
+        for (auto y = 0; y < h; ++y, sp += fb.m_pitch, dp += m_pitch) {
+            blend(dp, sp, w);
+        }
+        return;
+    }
+
+    // Mixed surface, walk the spans of each row that overlap the source rectangle
+    auto x0 = source.p0.x;
+    auto x1 = source.p1.x;
+    for (auto y = source.p0.y; y <= source.p1.y; ++y, sp += fb.m_pitch, dp += m_pitch) {
+        auto end = fb.m_rowSpans[y + 1];
+        for (auto i = fb.m_rowSpans[y]; i < end; ++i) {
+            const auto &span = fb.m_spans[i];
+            if (span.x1 < x0) {
+                continue;
+            }
+            if (span.x0 > x1) {
+                break;
+            }
+
+            auto sx0 = span.x0 > x0 ? span.x0 : x0;
+            auto sx1 = span.x1 < x1 ? span.x1 : x1;
+            auto count = sx1 - sx0 + 1;
+            auto offset = sx0 - x0;
+
+            switch (span.opacity) {
+                case OPACITY_OPAQUE:
+                    memcpy(dp + offset, sp + offset, count * sizeof(*dp));
+                    break;
+                case OPACITY_TRANSPARENT:
+                    break;
+                default:
+                    blend(dp + offset, sp + offset, count);
+                    break;
+            }
+        }
+    }
+}
+
+void CFrameBuffer::CopyPixels(const CFrameBuffer &fb, TRect source, TPoint dest) {
+    auto target = TRect(dest.x, dest.y, dest.x + source.Width() - 1, dest.y + source.Height() - 1);
+    if (!ClipCopy(m_rect, fb.m_rect, source, target)) {
+        return;
+    }
+
+    Invalidate();
+
     auto w = source.Width();
     auto h = source.Height();
+    auto sp = &fb.m_pixels[source.p0.y * fb.m_pitch + source.p0.x];
+    auto dp = &m_pixels[target.p0.y * m_pitch + target.p0.x];
+
+    // Within the same surface, copy the rows in the order that does not
+    // overwrite rows that are still to be read
+    if (&fb == this && target.p0.y > source.p0.y) {
+        sp += (h - 1) * fb.m_pitch;
+        dp += (h - 1) * m_pitch;
+        for (auto y = 0; y < h; ++y, sp -= fb.m_pitch, dp -= m_pitch) {
+            memmove(dp, sp, w * sizeof(*dp));
+        }
+    } else {
+        for (auto y = 0; y < h; ++y, sp += fb.m_pitch, dp += m_pitch) {
+            memmove(dp, sp, w * sizeof(*dp));
+        }
+    }
+}
+
+void CFrameBuffer::Submit(const TDrawCommand *commands, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        auto c = commands[i];
+        if (c.type == TDrawCommand::COPY || c.Clip(m_rect)) {
+            Rasterize(c);
+        }
+    }
+}
+
+void CFrameBuffer::Rasterize(const TDrawCommand &c) {
+    if (c.type == TDrawCommand::COPY) {
+        if (c.IsScaled()) {
+            auto copy = c;
+            auto scaled = ResolveScaledCopy(copy);
+            if (scaled) {
+                CFrameBuffer::CopyRect(*copy.image, copy.source, copy.rect);
+            }
+        } else {
+            CFrameBuffer::CopyRect(*c.image, c.source, c.rect);
+        }
+        return;
+    }
+
+    Invalidate();
+
+    auto w = c.rect.Width();
+    auto h = c.rect.Height();
+    auto dest = &m_pixels[c.rect.p0.y * m_pitch + c.rect.p0.x];
+
+    if (c.type == TDrawCommand::FILL) {
+        pixels::FillRect(dest, m_pitch, w, h, c.color);
+        return;
+    }
+
+    auto mask = c.mask + c.source.p0.y * c.maskPitch;
+    if (c.pixels) {
+        auto source = c.pixels + c.source.p0.y * c.pixelsPitch + c.source.p0.x;
+        for (auto y = 0; y < h; ++y, dest += m_pitch, mask += c.maskPitch, source += c.pixelsPitch) {
+            pixels::MaskCopyRow(dest, mask, c.source.p0.x, source, w);
+        }
+    } else {
+        for (auto y = 0; y < h; ++y, dest += m_pitch, mask += c.maskPitch) {
+            pixels::MaskFillRow(dest, mask, c.source.p0.x, c.color, w);
+        }
+    }
+}
+
+void CFrameBuffer::Premultiply() {
+    if (m_alphaMode == ALPHA_PREMULTIPLIED) {
+        return;
+    }
+
+    auto w = m_rect.Width();
+    auto h = m_rect.Height();
+    for (auto y = 0; y < h; ++y) {
+        pixels::PremultiplyRow(&m_pixels[y * m_pitch], w);
+    }
+
+    m_alphaMode = ALPHA_PREMULTIPLIED;
+    Invalidate();
+}
+
+CFrameBufferPtr CFrameBuffer::GetScaled(TRect source, int width, int height) const {
+    if (width <= 0 || height <= 0 || !source.Valid()) {
+        return nullptr;
+    }
+
+    // Scaling only makes sense for a source that lies entirely within the surface
+    if (!m_rect.Contains(source.p0.x, source.p0.y) || !m_rect.Contains(source.p1.x, source.p1.y)) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_scaledCopiesLock);
+    for (auto it = m_scaledCopies.begin(); it != m_scaledCopies.end(); ++it) {
+        if (it->width == width && it->height == height && it->filter == m_scaleFilter &&
+            it->source.p0.x == source.p0.x && it->source.p0.y == source.p0.y && it->source.p1.x == source.p1.x &&
+            it->source.p1.y == source.p1.y) {
+            auto copy = *it;
+            m_scaledCopies.erase(it);
+            m_scaledCopies.insert(m_scaledCopies.begin(), copy);
+            return copy.image;
+        }
+    }
+
+    auto image = CFrameBuffer::Create(nullptr, width, height, width * sizeof(uint32_t));
+    auto sp = &m_pixels[source.p0.y * m_pitch + source.p0.x];
+    if (m_scaleFilter == SCALE_NEAREST) {
+        pixels::ScaleNearest(image->m_pixels, image->m_pitch, width, height, sp, m_pitch, source.Width(),
+                             source.Height());
+    } else {
+        pixels::ScaleBilinear(image->m_pixels, image->m_pitch, width, height, sp, m_pitch, source.Width(),
+                              source.Height());
+    }
+    image->m_alphaMode = m_alphaMode;
+    image->Finalize();
+
+    if (m_scaledCopies.size() == MaxScaledCopies) {
+        m_scaledCopies.pop_back();
+    }
+    m_scaledCopies.insert(m_scaledCopies.begin(), TScaledCopy{source, width, height, m_scaleFilter, image});
+    return image;
+}
+
+CFrameBufferPtr CFrameBuffer::GetCopy(TRect &rect) const {
+    if (!m_rect.ClipRect(rect)) {
+        return nullptr;
+    }
+
+    auto w = rect.Width();
+    auto h = rect.Height();
+    auto copy = CFrameBuffer::Create(nullptr, w, h, w * sizeof(uint32_t));
+    auto sp = &m_pixels[rect.p0.y * m_pitch + rect.p0.x];
+    auto dp = copy->m_pixels;
+    for (auto y = 0; y < h; ++y, sp += m_pitch, dp += copy->m_pitch) {
+        memcpy(dp, sp, w * sizeof(*dp));
+    }
+    copy->m_alphaMode = m_alphaMode;
+    return copy;
+}
+
+static EOpacity GetPixelOpacity(uint32_t pixel) {
+    auto a = GetAlpha(pixel);
+    if (a == 0xff) {
+        return OPACITY_OPAQUE;
+    } else if (a == 0) {
+        return OPACITY_TRANSPARENT;
+    }
+    return OPACITY_MIXED;
+}
+
+void CFrameBuffer::Finalize() {
+    // Opaque or transparent runs shorter than this are folded into
+    // the neighboring mixed spans, the blend kernels handle them well
+    // enough and this keeps the span lists short.
+    static const int MinSpanWidth = 8;
+
+    auto w = m_rect.Width();
+    auto h = m_rect.Height();
+
+    m_spans.clear();
+    m_rowSpans.resize(h + 1);
+
+    bool hasOpaque = false, hasTransparent = false, hasMixed = false;
+
     for (auto y = 0; y < h; ++y) {
-        for (auto x = 0; x < w; ++x) {
-            auto sourcePixel = fb->GetPixel(source.p0.x + x, source.p0.y + y);
-            auto destPixel = GetPixel(dest.p0.x + x, dest.p0.y + y);
-            destPixel = ApplyAlphaBlend(sourcePixel, destPixel);
-            PutPixel(dest.p0.x + x, dest.p0.y + y, destPixel);
+        m_rowSpans[y] = m_spans.size();
+
+        auto row = &m_pixels[y * m_pitch];
+        auto x = 0;
+        while (x < w) {
+            auto opacity = GetPixelOpacity(row[x]);
+            auto x0 = x;
+            while (x < w && GetPixelOpacity(row[x]) == opacity) {
+                ++x;
+            }
+
+            if (opacity != OPACITY_MIXED && x - x0 < MinSpanWidth) {
+                opacity = OPACITY_MIXED;
+            }
+
+            hasOpaque |= opacity == OPACITY_OPAQUE;
+            hasTransparent |= opacity == OPACITY_TRANSPARENT;
+            hasMixed |= opacity == OPACITY_MIXED;
+
+            auto first = m_rowSpans[y];
+            if (m_spans.size() > first && m_spans.back().opacity == opacity) {
+                m_spans.back().x1 = x - 1;
+            } else {
+                m_spans.push_back({x0, x - 1, opacity});
+            }
         }
     }
+
+    m_rowSpans[h] = m_spans.size();
+
+    if (hasMixed || (hasOpaque && hasTransparent)) {
+        m_opacity = OPACITY_MIXED;
+    } else if (hasOpaque) {
+        m_opacity = OPACITY_OPAQUE;
+    } else {
+        m_opacity = OPACITY_TRANSPARENT;
+    }
+
+    if (m_opacity != OPACITY_MIXED) {
+        m_spans.clear();
+        m_rowSpans.clear();
+    }
 }
 
 void CFrameBuffer::DrawRect(TRect r, uint32_t color) {
@@ -67,11 +506,15 @@ void CFrameBuffer::DrawRect(TRect r, uint32_t color) {
         return;
     }
 
-    for (auto y = r.p0.y; y <= r.p1.y; ++y) {
-        for (auto x = r.p0.x; x <= r.p1.x; ++x) {
-            m_pixels[y * m_pitch + x] = color;
-        }
-    }
+    Invalidate();
+
+    pixels::FillRect(&m_pixels[r.p0.y * m_pitch + r.p0.x], m_pitch, r.Width(), r.Height(), color);
+}
+
+void CFrameBuffer::Fill(uint32_t color) {
+    Invalidate();
+
+    pixels::FillRect(m_pixels, m_pitch, m_rect.Width(), m_rect.Height(), color);
 }
 
 void CFrameBuffer::DrawHLine(TPoint p, int width, uint32_t color) {
@@ -79,9 +522,9 @@ void CFrameBuffer::DrawHLine(TPoint p, int width, uint32_t color) {
         return;
     }
 
-    for (int xi = p.x; xi < p.x + width; ++xi) {
-        m_pixels[p.y * m_pitch + xi] = color;
-    }
+    Invalidate();
+
+    pixels::FillRow(&m_pixels[p.y * m_pitch + p.x], color, width);
 }
 
 void CFrameBuffer::DrawVLine(TPoint p, int height, uint32_t color) {
@@ -89,8 +532,11 @@ void CFrameBuffer::DrawVLine(TPoint p, int height, uint32_t color) {
         return;
     }
 
-    for (int yi = p.y; yi < p.y + height; ++yi) {
-        m_pixels[(yi) *m_pitch + p.x] = color;
+    Invalidate();
+
+    auto dest = &m_pixels[p.y * m_pitch + p.x];
+    for (int yi = 0; yi < height; ++yi, dest += m_pitch) {
+        *dest = color;
     }
 }
 
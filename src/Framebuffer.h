@@ -25,6 +25,8 @@
 #include <assert.h>
 #include <inttypes.h>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "Rect.h"
 
@@ -35,27 +37,27 @@ class IFrameBuffer;
 using CFrameBufferPtr = std::shared_ptr<CFrameBuffer>;
 using IFrameBufferPtr = std::shared_ptr<IFrameBuffer>;
 
-static inline uint32_t RGB(uint8_t r, uint8_t g, uint8_t b) {
+static constexpr uint32_t RGB(uint8_t r, uint8_t g, uint8_t b) {
     return 0xff << 24 | r << 16 | g << 8 | b;
 }
 
-static inline uint32_t RGBA(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+static constexpr uint32_t RGBA(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
     return a << 24 | r << 16 | g << 8 | b;
 }
 
-static inline uint8_t GetAlpha(uint32_t color) {
+static constexpr uint8_t GetAlpha(uint32_t color) {
     return (uint8_t)(color >> 24);
 }
 
-static inline uint8_t GetRed(uint32_t color) {
+static constexpr uint8_t GetRed(uint32_t color) {
     return (uint8_t)(color >> 16) & 0xff;
 }
 
-static inline uint8_t GetGreen(uint32_t color) {
+static constexpr uint8_t GetGreen(uint32_t color) {
     return (uint8_t)(color >> 8) & 0xff;
 }
 
-static inline uint8_t GetBlue(uint32_t color) {
+static constexpr uint8_t GetBlue(uint32_t color) {
     return (uint8_t)(color) &0xff;
 }
 
@@ -79,6 +81,137 @@ static inline uint32_t ApplyAlphaBlend(uint32_t source, uint32_t dest) {
                 sb * sa + db * da * (1 - sa) / outa, outa * 255);
 }
 
+// Computes x / 255 rounded to the nearest integer, for 0 <= x <= 255 * 255
+static inline uint32_t Div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline uint32_t Premultiply(uint32_t color) {
+    auto a = GetAlpha(color);
+    return RGBA(Div255(GetRed(color) * a), Div255(GetGreen(color) * a), Div255(GetBlue(color) * a), a);
+}
+
+// Blends a premultiplied source over a premultiplied destination.
+// Opaque pixels are the same in both conventions, so this also works
+// for any opaque destination.
+static inline uint32_t ApplyPremultipliedBlend(uint32_t source, uint32_t dest) {
+    auto ia = 255 - GetAlpha(source);
+    return RGBA(GetRed(source) + Div255(GetRed(dest) * ia), GetGreen(source) + Div255(GetGreen(dest) * ia),
+                GetBlue(source) + Div255(GetBlue(dest) * ia), GetAlpha(source) + Div255(GetAlpha(dest) * ia));
+}
+
+enum EAlphaMode { ALPHA_STRAIGHT, ALPHA_PREMULTIPLIED };
+
+enum EScaleFilter { SCALE_NEAREST, SCALE_BILINEAR };
+
+enum EOpacity { OPACITY_UNKNOWN, OPACITY_OPAQUE, OPACITY_TRANSPARENT, OPACITY_MIXED };
+
+// A horizontal run of pixels [x0, x1] that have the same opacity
+struct TOpacitySpan {
+    int x0, x1;
+    EOpacity opacity;
+};
+
+// A drawing primitive that can be submitted in batches with IFrameBuffer::Submit().
+// Lines and pixels are fills of one pixel thick rectangles.
+struct TDrawCommand {
+    enum Type { FILL, COPY, MASK };
+
+    Type type;
+
+    // Destination area
+    TRect rect;
+
+    // FILL and MASK
+    uint32_t color;
+
+    // COPY: rectangle of image to copy to target, scaling it if the sizes differ.
+    // rect is the part of target that is left after clipping.
+    // MASK: position of rect.p0 in the mask
+    TRect source;
+    TRect target;
+    const CFrameBuffer *image;
+
+    // MASK: 1 bit per pixel bitmap, most significant bit first.
+    // Pixels whose bit is set are filled with color, or copied from
+    // pixels if it is not null. pixels has the same layout as the mask.
+    const uint8_t *mask;
+    int maskPitch;
+    const uint32_t *pixels;
+    int pixelsPitch;
+
+    static TDrawCommand Fill(TRect r, uint32_t color) {
+        TDrawCommand ret;
+        ret.type = FILL;
+        ret.rect = r;
+        ret.color = color;
+        return ret;
+    }
+
+    static TDrawCommand HLine(TPoint p, int width, uint32_t color) {
+        return Fill(TRect(p.x, p.y, p.x + width - 1, p.y), color);
+    }
+
+    static TDrawCommand VLine(TPoint p, int height, uint32_t color) {
+        return Fill(TRect(p.x, p.y, p.x, p.y + height - 1), color);
+    }
+
+    static TDrawCommand Pixel(int x, int y, uint32_t color) {
+        return Fill(TRect(x, y, x, y), color);
+    }
+
+    static TDrawCommand Copy(const CFrameBuffer &image, TRect source, TRect dest) {
+        TDrawCommand ret;
+        ret.type = COPY;
+        ret.rect = dest;
+        ret.source = source;
+        ret.target = dest;
+        ret.image = &image;
+        return ret;
+    }
+
+    static TDrawCommand Mask(TRect dest, const uint8_t *mask, int maskPitch, uint32_t color) {
+        TDrawCommand ret;
+        ret.type = MASK;
+        ret.rect = dest;
+        ret.color = color;
+        ret.source = TRect(0, 0, dest.Width() - 1, dest.Height() - 1);
+        ret.mask = mask;
+        ret.maskPitch = maskPitch;
+        ret.pixels = nullptr;
+        ret.pixelsPitch = 0;
+        return ret;
+    }
+
+    static TDrawCommand MaskedCopy(TRect dest, const uint8_t *mask, int maskPitch, const uint32_t *pixels,
+                                   int pixelsPitch) {
+        auto ret = Mask(dest, mask, maskPitch, 0);
+        ret.pixels = pixels;
+        ret.pixelsPitch = pixelsPitch;
+        return ret;
+    }
+
+    void Translate(TPoint p) {
+        rect.p0.x += p.x;
+        rect.p0.y += p.y;
+        rect.p1.x += p.x;
+        rect.p1.y += p.y;
+        target.p0.x += p.x;
+        target.p0.y += p.y;
+        target.p1.x += p.x;
+        target.p1.y += p.y;
+    }
+
+    bool IsScaled() const {
+        return type == COPY && (source.Width() != target.Width() || source.Height() != target.Height());
+    }
+
+    // Clips the destination area and adjusts the source accordingly.
+    // Returns false if nothing is left to draw.
+    bool Clip(const TRect &clip);
+};
+
 class IFrameBuffer {
 public:
     virtual void DrawRect(TRect r, uint32_t color) = 0;
@@ -86,7 +219,30 @@ public:
     virtual void DrawVLine(TPoint p, int height, uint32_t color) = 0;
     virtual void PutPixel(int x, int y, uint32_t color) = 0;
     virtual const TRect &GetRect() = 0;
-    virtual void CopyRect(CFrameBufferPtr fb, TRect source, TRect dest) = 0;
+    virtual void CopyRect(const CFrameBuffer &fb, TRect source, TRect dest) = 0;
+
+    // Draws a batch of commands, in order. Framebuffer wrappers transform
+    // the whole batch before passing it on, which is much cheaper than
+    // calling the primitives one by one.
+    virtual void Submit(const TDrawCommand *commands, size_t count);
+
+    void CopyRect(const CFrameBufferPtr &fb, TRect source, TRect dest) {
+        CopyRect(*fb.get(), source, dest);
+    }
+
+    // Fills the pixels of dest whose bit is set in the 1bpp mask.
+    // maskPitch is the size of a mask row in bytes.
+    void DrawMask(TRect dest, const uint8_t *mask, int maskPitch, uint32_t color) {
+        auto c = TDrawCommand::Mask(dest, mask, maskPitch, color);
+        Submit(&c, 1);
+    }
+
+    // Same as DrawMask, but copies the selected pixels from the given
+    // bitmap, which has pixelsPitch pixels per row.
+    void DrawMask(TRect dest, const uint8_t *mask, int maskPitch, const uint32_t *pixels, int pixelsPitch) {
+        auto c = TDrawCommand::MaskedCopy(dest, mask, maskPitch, pixels, pixelsPitch);
+        Submit(&c, 1);
+    }
 
     void DrawEmptyRect(TRect r, uint32_t color);
 };
@@ -105,13 +261,49 @@ public:
     }
 };
 
-class CFrameBuffer : public CFrameBufferBase {
+class CFrameBuffer : public CFrameBufferBase, public std::enable_shared_from_this<CFrameBuffer> {
 private:
     uint32_t *m_pixels;
     uint32_t m_pitch;
     bool m_ownsPixels;
+    EAlphaMode m_alphaMode;
+
+    // Opacity of the surface, computed by Finalize().
+    // Any drawing into the surface resets it to unknown.
+    EOpacity m_opacity;
+    std::vector<TOpacitySpan> m_spans;
+    // Index of the first span of each row in m_spans, plus one entry for the end
+    std::vector<uint32_t> m_rowSpans;
+
+    // Most recently used scaled copies of this surface
+    struct TScaledCopy {
+        TRect source;
+        int width, height;
+        EScaleFilter filter;
+        CFrameBufferPtr image;
+    };
+
+    static const size_t MaxScaledCopies = 4;
+
+    EScaleFilter m_scaleFilter;
+    // Images may be drawn by several threads at once
+    mutable std::mutex m_scaledCopiesLock;
+    mutable std::vector<TScaledCopy> m_scaledCopies;
+
+protected:
+    // For framebuffers that do not hold pixels
+    CFrameBuffer(int width, int height);
 
 public:
+    // Must be called whenever the pixels change. Drawing through this
+    // framebuffer does it, changing the pixels directly does not.
+    inline void Invalidate() {
+        m_opacity = OPACITY_UNKNOWN;
+        if (!m_scaledCopies.empty()) {
+            m_scaledCopies.clear();
+        }
+    }
+
     CFrameBuffer(uint32_t *pixels, int width, int height, uint32_t pitch);
 
     ~CFrameBuffer() {
@@ -127,6 +319,7 @@ public:
     virtual void PutPixel(int x, int y, uint32_t color) {
         if (m_rect.Contains(x, y)) {
             m_pixels[y * m_pitch + x] = color;
+            Invalidate();
         }
     }
 
@@ -140,15 +333,63 @@ public:
     virtual void DrawRect(TRect r, uint32_t color);
     virtual void DrawHLine(TPoint p, int width, uint32_t color);
     virtual void DrawVLine(TPoint p, int height, uint32_t color);
-    virtual void CopyRect(CFrameBufferPtr fb, TRect source, TRect dest);
+    virtual void CopyRect(const CFrameBuffer &fb, TRect source, TRect dest);
+    virtual void Submit(const TDrawCommand *commands, size_t count);
+    using IFrameBuffer::CopyRect;
+
+    // Copies the pixels of source in fb so that its top left corner lands on dest,
+    // without blending. fb may be this framebuffer, and the rectangles may overlap.
+    virtual void CopyPixels(const CFrameBuffer &fb, TRect source, TPoint dest);
+
+    void MoveRect(TRect source, TPoint dest) {
+        CopyPixels(*this, source, dest);
+    }
+
+    // Draws a command that was already clipped to the bounds of this framebuffer.
+    // Copies are clipped again to the bounds of the source.
+    virtual void Rasterize(const TDrawCommand &c);
+
+    void Fill(uint32_t color);
+
+    EAlphaMode GetAlphaMode() const {
+        return m_alphaMode;
+    }
+
+    // Records the alpha convention of the pixels without converting them
+    void SetAlphaMode(EAlphaMode mode) {
+        m_alphaMode = mode;
+    }
 
-    inline void Fill(uint32_t color) {
-        auto count = m_rect.Width() * m_rect.Height();
-        for (auto i = 0; i < count; ++i) {
-            m_pixels[i] = color;
+    // Converts straight-alpha pixels to premultiplied alpha
+    void Premultiply();
+
+    // Classifies the pixels into opaque, transparent and mixed spans.
+    // Call this once the contents of the surface are final, so that
+    // copying from it can skip or memcpy whole spans instead of blending.
+    void Finalize();
+
+    EOpacity GetOpacity() const {
+        return m_opacity;
+    }
+
+    // Filter used when this surface is copied to a rectangle of a different size
+    void SetScaleFilter(EScaleFilter filter) {
+        if (filter != m_scaleFilter) {
+            std::lock_guard<std::mutex> lock(m_scaledCopiesLock);
+            m_scaleFilter = filter;
+            m_scaledCopies.clear();
         }
     }
 
+    // Returns the source rectangle of this surface scaled to width x height.
+    // The result is cached, so drawing an image at the same size again
+    // does not scale it again.
+    CFrameBufferPtr GetScaled(TRect source, int width, int height) const;
+
+    // Returns a copy of the pixels of rect, after clipping rect to the bounds
+    // of this surface. Returns nullptr if nothing is left.
+    CFrameBufferPtr GetCopy(TRect &rect) const;
+
     inline uint32_t Pitch() const {
         return m_pitch * sizeof(*m_pixels);
     }
@@ -173,12 +414,15 @@ public:
         m_base.DrawRect(TRect(p0, p1), color);
     }
 
-    virtual void CopyRect(CFrameBufferPtr fb, TRect source, TRect dest) {
+    virtual void CopyRect(const CFrameBuffer &fb, TRect source, TRect dest) {
         auto p0 = TPoint(dest.p0.x + m_p.x, dest.p0.y + m_p.y);
         auto p1 = TPoint(dest.p1.x + m_p.x, dest.p1.y + m_p.y);
         m_base.CopyRect(fb, source, TRect(p0, p1));
     }
 
+    virtual void Submit(const TDrawCommand *commands, size_t count);
+    using IFrameBuffer::CopyRect;
+
     virtual void DrawHLine(TPoint p, int width, uint32_t color) {
         m_base.DrawHLine(TPoint(p.x + m_p.x, p.y + m_p.y), width, color);
     }
@@ -207,19 +451,16 @@ public:
         m_base.DrawRect(r, color);
     }
 
-    virtual void CopyRect(CFrameBufferPtr fb, TRect source, TRect dest) {
-        auto cdest = dest;
-        if (!m_rect.ClipRect(cdest)) {
-            return;
+    virtual void CopyRect(const CFrameBuffer &fb, TRect source, TRect dest) {
+        auto c = TDrawCommand::Copy(fb, source, dest);
+        if (c.Clip(m_rect)) {
+            m_base.Submit(&c, 1);
         }
-        source.p0.x += cdest.p0.x - dest.p0.x;
-        source.p0.y += cdest.p0.y - dest.p0.y;
-        source.p1.x += cdest.p1.x - dest.p1.x;
-        source.p1.y += cdest.p1.y - dest.p1.y;
-
-        m_base.CopyRect(fb, source, cdest);
     }
 
+    virtual void Submit(const TDrawCommand *commands, size_t count);
+    using IFrameBuffer::CopyRect;
+
     virtual void DrawHLine(TPoint p, int width, uint32_t color) {
         if (!m_rect.ClipHLine(p, width)) {
             return;
@@ -241,6 +482,82 @@ public:
     }
 };
 
+// A translated and clipped view of a framebuffer that writes straight to its pixels.
+// Both transformations are folded into one object whose primitives are inline,
+// so drawing through it costs a single virtual call instead of one per wrapper.
+// Views without Clip expect primitives to lie within the clip rectangle.
+template <bool Clip, bool Translate> class CFrameBufferView : public IFrameBuffer {
+private:
+    CFrameBuffer &m_fb;
+    TRect m_rect;
+    TPoint m_offset;
+    bool m_visible;
+
+    inline void Transform(TDrawCommand &c) const {
+        if (Translate) {
+            c.Translate(m_offset);
+        }
+    }
+
+    inline bool ClipCommand(TDrawCommand &c) const {
+        if (!m_visible || !c.rect.Valid()) {
+            return false;
+        }
+
+        if (Clip) {
+            return c.Clip(m_rect);
+        }
+
+        assert(m_rect.Contains(c.rect.p0.x, c.rect.p0.y) && m_rect.Contains(c.rect.p1.x, c.rect.p1.y));
+        return true;
+    }
+
+    inline void Draw(TDrawCommand c) {
+        Transform(c);
+        if (ClipCommand(c)) {
+            m_fb.Rasterize(c);
+        }
+    }
+
+public:
+    // clip and offset are in the coordinates of fb
+    CFrameBufferView(CFrameBuffer &fb, TRect clip, TPoint offset) : m_fb(fb), m_rect(clip), m_offset(offset) {
+        m_visible = fb.GetRect().ClipRect(m_rect);
+    }
+
+    virtual void DrawRect(TRect r, uint32_t color) {
+        Draw(TDrawCommand::Fill(r, color));
+    }
+
+    virtual void DrawHLine(TPoint p, int width, uint32_t color) {
+        Draw(TDrawCommand::HLine(p, width, color));
+    }
+
+    virtual void DrawVLine(TPoint p, int height, uint32_t color) {
+        Draw(TDrawCommand::VLine(p, height, color));
+    }
+
+    virtual void PutPixel(int x, int y, uint32_t color) {
+        Draw(TDrawCommand::Pixel(x, y, color));
+    }
+
+    virtual const TRect &GetRect() {
+        return m_rect;
+    }
+
+    virtual void CopyRect(const CFrameBuffer &fb, TRect source, TRect dest) {
+        Draw(TDrawCommand::Copy(fb, source, dest));
+    }
+
+    virtual void Submit(const TDrawCommand *commands, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            Draw(commands[i]);
+        }
+    }
+
+    using IFrameBuffer::CopyRect;
+};
+
 } // namespace gui
 
 #endif
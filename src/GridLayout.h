@@ -62,6 +62,11 @@ public:
 
     virtual void Draw(IFrameBuffer &fb) const;
 
+    // The layout itself is not drawn, the cells may not cover all of it
+    virtual bool IsOpaque() const {
+        return false;
+    }
+
     virtual void AddChild(const CWindowPtr &child);
     bool AddChild(const CWindowPtr &child, unsigned col, unsigned row, unsigned colspan = 1, unsigned rowspan = 1);
     virtual bool RemoveChild(CWindow *child);
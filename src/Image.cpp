@@ -32,6 +32,20 @@ void CImage::Draw(IFrameBuffer &fb) const {
     auto dest = m_image->GetRect();
     auto ih = dest.Height();
     auto iw = dest.Width();
+
+    if (m_scaleToFit && (iw > GetWidth() || ih > GetHeight())) {
+        if (iw * GetHeight() > ih * GetWidth()) {
+            ih = ih * GetWidth() / iw;
+            iw = GetWidth();
+        } else {
+            iw = iw * GetHeight() / ih;
+            ih = GetHeight();
+        }
+        iw = iw > 0 ? iw : 1;
+        ih = ih > 0 ? ih : 1;
+        dest.p1.x = dest.p0.x + iw - 1;
+        dest.p1.y = dest.p0.y + ih - 1;
+    }
     if (m_verticalCenter) {
         dest.p0.y += (GetHeight() - ih) / 2;
         dest.p1.y += (GetHeight() - ih) / 2;
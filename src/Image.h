@@ -39,11 +39,12 @@ private:
 
     bool m_verticalCenter;
     bool m_horizontalCenter;
+    bool m_scaleToFit;
 
-    // For now, the image control has to be at least the same size as the actual image.
-    // TODO: support arbitrary size.
+    // Unless the image is scaled to fit, the image control has to be
+    // at least the same size as the actual image.
     void ResizeRect() {
-        if (!m_image) {
+        if (!m_image || m_scaleToFit) {
             return;
         }
 
@@ -61,6 +62,7 @@ public:
     CImage(const this_is_private &p, TRect rect) : CWindow(p, rect) {
         m_verticalCenter = false;
         m_horizontalCenter = false;
+        m_scaleToFit = false;
     }
 
     void SetVCenter(bool b) {
@@ -73,14 +75,22 @@ public:
         SetDirty(true);
     }
 
+    // Images bigger than the control are scaled down to fit it, keeping their aspect ratio
+    void SetScaleToFit(bool b) {
+        m_scaleToFit = b;
+        ResizeRect();
+        SetDirty(true);
+    }
+
     bool SetImage(const std::string &imagePath) {
-        auto image = LoadImage(imagePath);
+        auto image = LoadCachedImage(imagePath);
         if (!image) {
             return false;
         }
 
         m_image = image;
         ResizeRect();
+        SetDirty(true);
         return true;
     }
 
@@ -94,6 +104,16 @@ public:
     }
 
     virtual void Draw(IFrameBuffer &fb) const;
+
+    // The image is blended and may not cover the whole control
+    virtual bool IsOpaque() const {
+        return !m_image;
+    }
+
+    // Images larger than the control are only shrunk when scaled to fit
+    virtual bool DrawsInsideBounds() const {
+        return false;
+    }
 };
 
 } // namespace gui
@@ -19,6 +19,8 @@
 /// SOFTWARE.
 
 #include <libpng/png.h>
+#include <mutex>
+#include <unordered_map>
 
 #include "Image.h"
 #include "Utils.h"
@@ -129,6 +131,10 @@ CFrameBufferPtr LoadImage(const std::string &path) {
 
     png_read_image(png, rows.get());
 
+    // Blending premultiplied pixels is much cheaper, convert them once here
+    fb->Premultiply();
+    fb->Finalize();
+
 err:
     if (png || info) {
         png_destroy_read_struct(&png, &info, nullptr);
@@ -136,4 +142,27 @@ err:
     return fb;
 }
 
+CFrameBufferPtr LoadCachedImage(const std::string &path) {
+    static std::mutex lock;
+    static std::unordered_map<std::string, CFrameBufferPtr> images;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = images.find(path);
+        if (it != images.end()) {
+            return it->second;
+        }
+    }
+
+    // Decoding is done without the lock, so that several images are loaded at once.
+    // The first image stored wins if the same file is loaded twice meanwhile.
+    auto image = LoadImage(path);
+    if (!image) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    return images.emplace(path, image).first->second;
+}
+
 } // namespace gui
@@ -28,6 +28,10 @@
 
 namespace gui {
 CFrameBufferPtr LoadImage(const std::string &path);
-}
+
+// Same as LoadImage, but each file is decoded once and the image is shared
+// by all the callers. Can be called from several threads.
+CFrameBufferPtr LoadCachedImage(const std::string &path);
+} // namespace gui
 
 #endif
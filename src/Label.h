@@ -81,6 +81,15 @@ public:
     }
 
     virtual void Draw(IFrameBuffer &fb) const;
+
+    virtual bool IsOpaque() const {
+        return !m_transparent;
+    }
+
+    // The text is not wrapped and may extend past the label
+    virtual bool DrawsInsideBounds() const {
+        return false;
+    }
 };
 
 } // namespace gui
@@ -46,13 +46,11 @@ public:
 
         auto imageRect = TRect(0, 0, 63, 63);
         m_image = CImage::Create(imageRect);
+        m_image->SetScaleToFit(true);
         m_image->SetImage(imagePath);
         m_image->SetHCenter(true);
         m_image->SetVCenter(true);
 
-        // The rectangle might have been resized if the image is bigger
-        imageRect = m_image->GetRect();
-
         // Horizontally center the icon
         auto iw = imageRect.Width();
         imageRect.p0.x += (rect.Width() - iw) / 2;
@@ -88,6 +86,10 @@ public:
 
     virtual void Draw(IFrameBuffer &fb) const;
 
+    virtual bool IsOpaque() const {
+        return !m_transparent;
+    }
+
     virtual void SetRect(TRect r) {
         CWindow::SetRect(r);
         // TODO: fix this
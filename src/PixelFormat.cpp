@@ -0,0 +1,53 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+#include <string.h>
+
+#include "PixelFormat.h"
+
+namespace gui {
+
+bool ConvertPixels(EPixelFormat format, void *dest, uint32_t destPitch, const uint32_t *source,
+                   uint32_t sourcePitch, int width, int height) {
+    switch (format) {
+        case PIXEL_FORMAT_XRGB8888:
+        case PIXEL_FORMAT_ARGB8888: {
+            auto dp = (uint8_t *) dest;
+            for (auto y = 0; y < height; ++y, dp += destPitch, source += sourcePitch) {
+                memcpy(dp, source, width * sizeof(*source));
+            }
+        } break;
+
+        case PIXEL_FORMAT_BGRA8888:
+            ConvertPixels<PIXEL_FORMAT_BGRA8888>(dest, destPitch, source, sourcePitch, width, height);
+            break;
+
+        case PIXEL_FORMAT_RGB565:
+            ConvertPixels<PIXEL_FORMAT_RGB565>(dest, destPitch, source, sourcePitch, width, height);
+            break;
+
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace gui
@@ -0,0 +1,104 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+#ifndef __GUI_PIXELFORMAT_H__
+
+#define __GUI_PIXELFORMAT_H__
+
+#include <inttypes.h>
+
+namespace gui {
+
+// Pixel layouts of the surfaces the framebuffer can be presented on.
+// The framebuffer itself always renders 32-bit ARGB pixels.
+enum EPixelFormat {
+    PIXEL_FORMAT_UNKNOWN,
+    // 0xXXRRGGBB, the alpha byte is ignored
+    PIXEL_FORMAT_XRGB8888,
+    // 0xAARRGGBB
+    PIXEL_FORMAT_ARGB8888,
+    // 0xBBGGRRAA
+    PIXEL_FORMAT_BGRA8888,
+    // 16-bit, 5 bits of red, 6 of green, 5 of blue
+    PIXEL_FORMAT_RGB565
+};
+
+template <EPixelFormat Format> struct TPixelFormat;
+
+template <> struct TPixelFormat<PIXEL_FORMAT_XRGB8888> {
+    using Pixel = uint32_t;
+
+    static constexpr Pixel FromARGB(uint32_t color) {
+        return color;
+    }
+};
+
+template <> struct TPixelFormat<PIXEL_FORMAT_ARGB8888> {
+    using Pixel = uint32_t;
+
+    static constexpr Pixel FromARGB(uint32_t color) {
+        return color;
+    }
+};
+
+template <> struct TPixelFormat<PIXEL_FORMAT_BGRA8888> {
+    using Pixel = uint32_t;
+
+    static constexpr Pixel FromARGB(uint32_t color) {
+        return (color >> 24) | ((color >> 8) & 0xff00) | ((color << 8) & 0xff0000) | (color << 24);
+    }
+};
+
+template <> struct TPixelFormat<PIXEL_FORMAT_RGB565> {
+    using Pixel = uint16_t;
+
+    static constexpr Pixel FromARGB(uint32_t color) {
+        return (Pixel)(((color >> 8) & 0xf800) | ((color >> 5) & 0x07e0) | ((color >> 3) & 0x001f));
+    }
+};
+
+// Converts a width x height rectangle of ARGB pixels to Format.
+// sourcePitch is in pixels, destPitch in bytes.
+template <EPixelFormat Format>
+void ConvertPixels(void *dest, uint32_t destPitch, const uint32_t *source, uint32_t sourcePitch, int width,
+                   int height) {
+    using Traits = TPixelFormat<Format>;
+    auto dp = (uint8_t *) dest;
+    for (auto y = 0; y < height; ++y, dp += destPitch, source += sourcePitch) {
+        auto row = (typename Traits::Pixel *) dp;
+        for (auto x = 0; x < width; ++x) {
+            row[x] = Traits::FromARGB(source[x]);
+        }
+    }
+}
+
+// Same as ConvertPixels, for a format known at run time.
+// Returns false if the format is not supported.
+bool ConvertPixels(EPixelFormat format, void *dest, uint32_t destPitch, const uint32_t *source,
+                   uint32_t sourcePitch, int width, int height);
+
+// Returns true if the framebuffer can render directly to surfaces of this format
+static constexpr bool IsNativePixelFormat(EPixelFormat format) {
+    return format == PIXEL_FORMAT_ARGB8888 || format == PIXEL_FORMAT_XRGB8888;
+}
+
+} // namespace gui
+
+#endif
@@ -0,0 +1,692 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#include <immintrin.h>
+#define GUI_X86_KERNELS
+#endif
+
+#include <string.h>
+#include <vector>
+
+#include "Framebuffer.h"
+#include "PixelOps.h"
+
+namespace gui {
+namespace pixels {
+
+namespace {
+
+using BlendRowFn = void (*)(uint32_t *, const uint32_t *, int);
+using FillRowFn = void (*)(uint32_t *, uint32_t, int);
+using MaskRowFn = void (*)(uint32_t *, const uint8_t *, int, uint32_t, const uint32_t *, int);
+using GatherRowFn = void (*)(uint32_t *, const uint32_t *, const int32_t *, int);
+using LerpRowFn = void (*)(uint32_t *, const uint32_t *, const uint32_t *, uint32_t, int);
+using ResampleRowFn = void (*)(uint32_t *, const uint32_t *, const int32_t *, const uint32_t *, int);
+
+struct TKernels {
+    const char *Name;
+    BlendRowFn BlendRow;
+    BlendRowFn BlendRowPremultiplied;
+    FillRowFn FillRow;
+    // Same as FillRow, with non-temporal stores
+    FillRowFn FillRowStream;
+    void (*StreamFence)();
+    MaskRowFn MaskFillRow;
+    MaskRowFn MaskCopyRow;
+    // dest[i] = source[index[i]]
+    GatherRowFn GatherRow;
+    // Interpolates each channel between a and b, weight is in [0, 256]
+    LerpRowFn LerpRow;
+    // Interpolates dest[i] between source[column[i]] and source[column[i] + 1], weight[i] is in [0, 255]
+    ResampleRowFn ResampleRow;
+};
+
+// Rectangles bigger than this are filled with non-temporal stores
+const size_t StreamingFillThreshold = 512 * 1024;
+
+// Opaque destinations are blended with the same rounding as the vector kernels
+inline void BlendPixel(uint32_t &dest, uint32_t source) {
+    auto a = GetAlpha(source);
+    if (a == 0xff) {
+        dest = source;
+    } else if (a && GetAlpha(dest) == 0xff) {
+        auto ia = 255 - a;
+        dest = RGBA(Div255(GetRed(source) * a + GetRed(dest) * ia), Div255(GetGreen(source) * a + GetGreen(dest) * ia),
+                    Div255(GetBlue(source) * a + GetBlue(dest) * ia), 0xff);
+    } else if (a) {
+        dest = ApplyAlphaBlend(source, dest);
+    }
+}
+
+void BlendRowScalar(uint32_t *dest, const uint32_t *source, int count) {
+    for (auto i = 0; i < count; ++i) {
+        BlendPixel(dest[i], source[i]);
+    }
+}
+
+void BlendRowPremultipliedScalar(uint32_t *dest, const uint32_t *source, int count) {
+    for (auto i = 0; i < count; ++i) {
+        auto a = GetAlpha(source[i]);
+        if (a == 0xff) {
+            dest[i] = source[i];
+        } else if (a) {
+            dest[i] = ApplyPremultipliedBlend(source[i], dest[i]);
+        }
+    }
+}
+
+void FillRowScalar(uint32_t *dest, uint32_t color, int count) {
+    for (auto i = 0; i < count; ++i) {
+        dest[i] = color;
+    }
+}
+
+template <bool Copy>
+void MaskRowScalar(uint32_t *dest, const uint8_t *mask, int firstBit, uint32_t color, const uint32_t *source,
+                   int count) {
+    for (auto i = 0; i < count; ++i) {
+        auto bit = firstBit + i;
+        if (mask[bit / 8] & (0x80 >> (bit % 8))) {
+            dest[i] = Copy ? source[i] : color;
+        }
+    }
+}
+
+// Interpolates the four channels of a and b at once, two channels per 16-bit lane
+inline uint32_t LerpPixel(uint32_t a, uint32_t b, uint32_t weight) {
+    auto rb = ((a & 0x00ff00ff) * (256 - weight) + (b & 0x00ff00ff) * weight) >> 8;
+    auto ag = ((a >> 8) & 0x00ff00ff) * (256 - weight) + ((b >> 8) & 0x00ff00ff) * weight;
+    return (rb & 0x00ff00ff) | (ag & 0xff00ff00);
+}
+
+void GatherRowScalar(uint32_t *dest, const uint32_t *source, const int32_t *index, int count) {
+    for (auto i = 0; i < count; ++i) {
+        dest[i] = source[index[i]];
+    }
+}
+
+void LerpRowScalar(uint32_t *dest, const uint32_t *a, const uint32_t *b, uint32_t weight, int count) {
+    for (auto i = 0; i < count; ++i) {
+        dest[i] = LerpPixel(a[i], b[i], weight);
+    }
+}
+
+void ResampleRowScalar(uint32_t *dest, const uint32_t *source, const int32_t *column, const uint32_t *weight,
+                       int count) {
+    for (auto i = 0; i < count; ++i) {
+        dest[i] = LerpPixel(source[column[i]], source[column[i] + 1], weight[i]);
+    }
+}
+
+#ifndef GUI_X86_KERNELS
+void StreamFenceScalar() {
+}
+#endif
+
+#ifdef GUI_X86_KERNELS
+
+// Stores single pixels until dest is aligned on Alignment bytes, returns the number of pixels written
+template <unsigned Alignment> inline int FillHead(uint32_t *dest, uint32_t color, int count) {
+    auto i = 0;
+    while (i < count && ((uintptr_t) &dest[i] & (Alignment - 1))) {
+        dest[i++] = color;
+    }
+    return i;
+}
+
+template <bool Stream> void FillRowSSE2(uint32_t *dest, uint32_t color, int count) {
+    auto i = FillHead<16>(dest, color, count);
+    auto c = _mm_set1_epi32(color);
+    for (; i + 16 <= count; i += 16) {
+        if (Stream) {
+            _mm_stream_si128((__m128i *) &dest[i], c);
+            _mm_stream_si128((__m128i *) &dest[i + 4], c);
+            _mm_stream_si128((__m128i *) &dest[i + 8], c);
+            _mm_stream_si128((__m128i *) &dest[i + 12], c);
+        } else {
+            _mm_store_si128((__m128i *) &dest[i], c);
+            _mm_store_si128((__m128i *) &dest[i + 4], c);
+            _mm_store_si128((__m128i *) &dest[i + 8], c);
+            _mm_store_si128((__m128i *) &dest[i + 12], c);
+        }
+    }
+    for (; i + 4 <= count; i += 4) {
+        _mm_store_si128((__m128i *) &dest[i], c);
+    }
+    FillRowScalar(&dest[i], color, count - i);
+}
+
+template <bool Stream> __attribute__((target("avx2"))) void FillRowAVX2(uint32_t *dest, uint32_t color, int count) {
+    auto i = FillHead<32>(dest, color, count);
+    auto c = _mm256_set1_epi32(color);
+    for (; i + 32 <= count; i += 32) {
+        if (Stream) {
+            _mm256_stream_si256((__m256i *) &dest[i], c);
+            _mm256_stream_si256((__m256i *) &dest[i + 8], c);
+            _mm256_stream_si256((__m256i *) &dest[i + 16], c);
+            _mm256_stream_si256((__m256i *) &dest[i + 24], c);
+        } else {
+            _mm256_store_si256((__m256i *) &dest[i], c);
+            _mm256_store_si256((__m256i *) &dest[i + 8], c);
+            _mm256_store_si256((__m256i *) &dest[i + 16], c);
+            _mm256_store_si256((__m256i *) &dest[i + 24], c);
+        }
+    }
+    for (; i + 8 <= count; i += 8) {
+        _mm256_store_si256((__m256i *) &dest[i], c);
+    }
+    FillRowScalar(&dest[i], color, count - i);
+}
+
+void StreamFenceSSE2() {
+    _mm_sfence();
+}
+
+// Expands one mask byte at a time into two vectors of lane masks
+template <bool Copy>
+void MaskRowSSE2(uint32_t *dest, const uint8_t *mask, int firstBit, uint32_t color, const uint32_t *source,
+                 int count) {
+    const auto bitsLo = _mm_setr_epi32(0x80, 0x40, 0x20, 0x10);
+    const auto bitsHi = _mm_setr_epi32(0x08, 0x04, 0x02, 0x01);
+    const auto c = _mm_set1_epi32(color);
+
+    // Leading bits up to a byte boundary
+    auto i = (8 - firstBit % 8) % 8;
+    if (i > count) {
+        i = count;
+    }
+    MaskRowScalar<Copy>(dest, mask, firstBit, color, source, i);
+
+    auto m = mask + (firstBit + i) / 8;
+    for (; i + 8 <= count; i += 8, ++m) {
+        auto bits = *m;
+        if (!bits) {
+            continue;
+        }
+
+        auto lo = Copy ? _mm_loadu_si128((const __m128i *) &source[i]) : c;
+        auto hi = Copy ? _mm_loadu_si128((const __m128i *) &source[i + 4]) : c;
+
+        if (bits != 0xff) {
+            auto b = _mm_set1_epi32(bits);
+            auto mlo = _mm_cmpeq_epi32(_mm_and_si128(b, bitsLo), bitsLo);
+            auto mhi = _mm_cmpeq_epi32(_mm_and_si128(b, bitsHi), bitsHi);
+            auto dlo = _mm_loadu_si128((const __m128i *) &dest[i]);
+            auto dhi = _mm_loadu_si128((const __m128i *) &dest[i + 4]);
+            lo = _mm_or_si128(_mm_and_si128(mlo, lo), _mm_andnot_si128(mlo, dlo));
+            hi = _mm_or_si128(_mm_and_si128(mhi, hi), _mm_andnot_si128(mhi, dhi));
+        }
+
+        _mm_storeu_si128((__m128i *) &dest[i], lo);
+        _mm_storeu_si128((__m128i *) &dest[i + 4], hi);
+    }
+
+    MaskRowScalar<Copy>(&dest[i], mask, firstBit + i, color, Copy ? &source[i] : nullptr, count - i);
+}
+
+// The vector kernels handle the common case of an opaque destination, for which
+// out = (s * a + d * (255 - a)) / 255. Groups of pixels that have a translucent
+// destination go through the scalar blend.
+
+void BlendRowSSE2(uint32_t *dest, const uint32_t *source, int count) {
+    const auto alphaMask = _mm_set1_epi32(0xff000000);
+    const auto zero = _mm_setzero_si128();
+    const auto c255 = _mm_set1_epi16(255);
+    const auto c128 = _mm_set1_epi16(128);
+
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto s = _mm_loadu_si128((const __m128i *) &source[i]);
+        auto sa = _mm_and_si128(s, alphaMask);
+        auto opaque = _mm_movemask_epi8(_mm_cmpeq_epi32(sa, alphaMask));
+        if (opaque == 0xffff) {
+            _mm_storeu_si128((__m128i *) &dest[i], s);
+            continue;
+        }
+
+        auto transparent = _mm_movemask_epi8(_mm_cmpeq_epi32(sa, zero));
+        if (transparent == 0xffff) {
+            continue;
+        }
+
+        auto d = _mm_loadu_si128((const __m128i *) &dest[i]);
+        auto da = _mm_and_si128(d, alphaMask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(da, alphaMask)) != 0xffff) {
+            BlendRowScalar(&dest[i], &source[i], 4);
+            continue;
+        }
+
+        auto slo = _mm_unpacklo_epi8(s, zero);
+        auto shi = _mm_unpackhi_epi8(s, zero);
+        auto dlo = _mm_unpacklo_epi8(d, zero);
+        auto dhi = _mm_unpackhi_epi8(d, zero);
+
+        auto alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(slo, 0xff), 0xff);
+        auto ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(shi, 0xff), 0xff);
+
+        auto lo = _mm_add_epi16(_mm_mullo_epi16(slo, alo), _mm_mullo_epi16(dlo, _mm_sub_epi16(c255, alo)));
+        auto hi = _mm_add_epi16(_mm_mullo_epi16(shi, ahi), _mm_mullo_epi16(dhi, _mm_sub_epi16(c255, ahi)));
+
+        // Exact division by 255 with rounding
+        lo = _mm_add_epi16(lo, c128);
+        hi = _mm_add_epi16(hi, c128);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+        auto res = _mm_or_si128(_mm_packus_epi16(lo, hi), alphaMask);
+        _mm_storeu_si128((__m128i *) &dest[i], res);
+    }
+
+    BlendRowScalar(&dest[i], &source[i], count - i);
+}
+
+// out = s + d * (255 - a) / 255, applied to all four channels
+void BlendRowPremultipliedSSE2(uint32_t *dest, const uint32_t *source, int count) {
+    const auto alphaMask = _mm_set1_epi32(0xff000000);
+    const auto zero = _mm_setzero_si128();
+    const auto c255 = _mm_set1_epi16(255);
+    const auto c128 = _mm_set1_epi16(128);
+
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto s = _mm_loadu_si128((const __m128i *) &source[i]);
+        auto sa = _mm_and_si128(s, alphaMask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, alphaMask)) == 0xffff) {
+            _mm_storeu_si128((__m128i *) &dest[i], s);
+            continue;
+        }
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, zero)) == 0xffff) {
+            continue;
+        }
+
+        auto d = _mm_loadu_si128((const __m128i *) &dest[i]);
+        auto slo = _mm_unpacklo_epi8(s, zero);
+        auto shi = _mm_unpackhi_epi8(s, zero);
+        auto dlo = _mm_unpacklo_epi8(d, zero);
+        auto dhi = _mm_unpackhi_epi8(d, zero);
+
+        auto alo = _mm_sub_epi16(c255, _mm_shufflehi_epi16(_mm_shufflelo_epi16(slo, 0xff), 0xff));
+        auto ahi = _mm_sub_epi16(c255, _mm_shufflehi_epi16(_mm_shufflelo_epi16(shi, 0xff), 0xff));
+
+        auto lo = _mm_add_epi16(_mm_mullo_epi16(dlo, alo), c128);
+        auto hi = _mm_add_epi16(_mm_mullo_epi16(dhi, ahi), c128);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+        auto res = _mm_add_epi8(_mm_packus_epi16(lo, hi), s);
+        _mm_storeu_si128((__m128i *) &dest[i], res);
+    }
+
+    BlendRowPremultipliedScalar(&dest[i], &source[i], count - i);
+}
+
+__attribute__((target("avx2"))) void BlendRowAVX2(uint32_t *dest, const uint32_t *source, int count) {
+    const auto alphaMask = _mm256_set1_epi32(0xff000000);
+    const auto zero = _mm256_setzero_si256();
+    const auto c255 = _mm256_set1_epi16(255);
+    const auto c128 = _mm256_set1_epi16(128);
+    const auto alphaShuffle =
+        _mm256_setr_epi8(6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15, 6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14,
+                         15, 14, 15, 14, 15);
+
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto s = _mm256_loadu_si256((const __m256i *) &source[i]);
+        auto sa = _mm256_and_si256(s, alphaMask);
+        if ((uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, alphaMask)) == 0xffffffff) {
+            _mm256_storeu_si256((__m256i *) &dest[i], s);
+            continue;
+        }
+
+        if ((uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, zero)) == 0xffffffff) {
+            continue;
+        }
+
+        auto d = _mm256_loadu_si256((const __m256i *) &dest[i]);
+        auto da = _mm256_and_si256(d, alphaMask);
+        if ((uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi32(da, alphaMask)) != 0xffffffff) {
+            BlendRowScalar(&dest[i], &source[i], 8);
+            continue;
+        }
+
+        auto slo = _mm256_unpacklo_epi8(s, zero);
+        auto shi = _mm256_unpackhi_epi8(s, zero);
+        auto dlo = _mm256_unpacklo_epi8(d, zero);
+        auto dhi = _mm256_unpackhi_epi8(d, zero);
+
+        auto alo = _mm256_shuffle_epi8(slo, alphaShuffle);
+        auto ahi = _mm256_shuffle_epi8(shi, alphaShuffle);
+
+        auto lo = _mm256_add_epi16(_mm256_mullo_epi16(slo, alo), _mm256_mullo_epi16(dlo, _mm256_sub_epi16(c255, alo)));
+        auto hi = _mm256_add_epi16(_mm256_mullo_epi16(shi, ahi), _mm256_mullo_epi16(dhi, _mm256_sub_epi16(c255, ahi)));
+
+        lo = _mm256_add_epi16(lo, c128);
+        hi = _mm256_add_epi16(hi, c128);
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+
+        auto res = _mm256_or_si256(_mm256_packus_epi16(lo, hi), alphaMask);
+        _mm256_storeu_si256((__m256i *) &dest[i], res);
+    }
+
+    BlendRowSSE2(&dest[i], &source[i], count - i);
+}
+
+__attribute__((target("avx2"))) void BlendRowPremultipliedAVX2(uint32_t *dest, const uint32_t *source, int count) {
+    const auto alphaMask = _mm256_set1_epi32(0xff000000);
+    const auto zero = _mm256_setzero_si256();
+    const auto c255 = _mm256_set1_epi16(255);
+    const auto c128 = _mm256_set1_epi16(128);
+    const auto alphaShuffle =
+        _mm256_setr_epi8(6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15, 6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14,
+                         15, 14, 15, 14, 15);
+
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto s = _mm256_loadu_si256((const __m256i *) &source[i]);
+        auto sa = _mm256_and_si256(s, alphaMask);
+        if ((uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, alphaMask)) == 0xffffffff) {
+            _mm256_storeu_si256((__m256i *) &dest[i], s);
+            continue;
+        }
+
+        if ((uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, zero)) == 0xffffffff) {
+            continue;
+        }
+
+        auto d = _mm256_loadu_si256((const __m256i *) &dest[i]);
+        auto slo = _mm256_unpacklo_epi8(s, zero);
+        auto shi = _mm256_unpackhi_epi8(s, zero);
+        auto dlo = _mm256_unpacklo_epi8(d, zero);
+        auto dhi = _mm256_unpackhi_epi8(d, zero);
+
+        auto alo = _mm256_sub_epi16(c255, _mm256_shuffle_epi8(slo, alphaShuffle));
+        auto ahi = _mm256_sub_epi16(c255, _mm256_shuffle_epi8(shi, alphaShuffle));
+
+        auto lo = _mm256_add_epi16(_mm256_mullo_epi16(dlo, alo), c128);
+        auto hi = _mm256_add_epi16(_mm256_mullo_epi16(dhi, ahi), c128);
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+
+        auto res = _mm256_add_epi8(_mm256_packus_epi16(lo, hi), s);
+        _mm256_storeu_si256((__m256i *) &dest[i], res);
+    }
+
+    BlendRowPremultipliedSSE2(&dest[i], &source[i], count - i);
+}
+
+void LerpRowSSE2(uint32_t *dest, const uint32_t *a, const uint32_t *b, uint32_t weight, int count) {
+    const auto zero = _mm_setzero_si128();
+    const auto wb = _mm_set1_epi16((short) weight);
+    const auto wa = _mm_set1_epi16((short) (256 - weight));
+
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto va = _mm_loadu_si128((const __m128i *) &a[i]);
+        auto vb = _mm_loadu_si128((const __m128i *) &b[i]);
+        auto lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                                _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+        auto hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                                _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+        auto res = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+        _mm_storeu_si128((__m128i *) &dest[i], res);
+    }
+
+    LerpRowScalar(&dest[i], &a[i], &b[i], weight, count - i);
+}
+
+// Interpolates two destination pixels. Each one is computed from its two source
+// pixels, which are loaded together and weighted in one 16-bit multiply.
+inline __m128i ResamplePairSSE2(const uint32_t *source, const int32_t *column, const uint32_t *weight) {
+    const auto zero = _mm_setzero_si128();
+    auto p0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) &source[column[0]]), zero);
+    auto p1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) &source[column[1]]), zero);
+
+    // Left pixel in the low four lanes, right pixel in the high ones
+    auto w0 = _mm_unpacklo_epi64(_mm_set1_epi16((short) (256 - weight[0])), _mm_set1_epi16((short) weight[0]));
+    auto w1 = _mm_unpacklo_epi64(_mm_set1_epi16((short) (256 - weight[1])), _mm_set1_epi16((short) weight[1]));
+    p0 = _mm_mullo_epi16(p0, w0);
+    p1 = _mm_mullo_epi16(p1, w1);
+
+    auto sum0 = _mm_add_epi16(p0, _mm_srli_si128(p0, 8));
+    auto sum1 = _mm_add_epi16(p1, _mm_srli_si128(p1, 8));
+    return _mm_srli_epi16(_mm_unpacklo_epi64(sum0, sum1), 8);
+}
+
+void ResampleRowSSE2(uint32_t *dest, const uint32_t *source, const int32_t *column, const uint32_t *weight,
+                     int count) {
+    auto i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto lo = ResamplePairSSE2(source, &column[i], &weight[i]);
+        auto hi = ResamplePairSSE2(source, &column[i + 2], &weight[i + 2]);
+        _mm_storeu_si128((__m128i *) &dest[i], _mm_packus_epi16(lo, hi));
+    }
+
+    ResampleRowScalar(&dest[i], source, &column[i], &weight[i], count - i);
+}
+
+__attribute__((target("avx2"))) void LerpRowAVX2(uint32_t *dest, const uint32_t *a, const uint32_t *b,
+                                                 uint32_t weight, int count) {
+    const auto zero = _mm256_setzero_si256();
+    const auto wb = _mm256_set1_epi16((short) weight);
+    const auto wa = _mm256_set1_epi16((short) (256 - weight));
+
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto va = _mm256_loadu_si256((const __m256i *) &a[i]);
+        auto vb = _mm256_loadu_si256((const __m256i *) &b[i]);
+        auto lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(va, zero), wa),
+                                   _mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, zero), wb));
+        auto hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(va, zero), wa),
+                                   _mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, zero), wb));
+        auto res = _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8));
+        _mm256_storeu_si256((__m256i *) &dest[i], res);
+    }
+
+    LerpRowSSE2(&dest[i], &a[i], &b[i], weight, count - i);
+}
+
+__attribute__((target("avx2"))) void GatherRowAVX2(uint32_t *dest, const uint32_t *source, const int32_t *index,
+                                                   int count) {
+    auto i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto idx = _mm256_loadu_si256((const __m256i *) &index[i]);
+        auto res = _mm256_i32gather_epi32((const int *) source, idx, 4);
+        _mm256_storeu_si256((__m256i *) &dest[i], res);
+    }
+
+    GatherRowScalar(&dest[i], source, &index[i], count - i);
+}
+
+#endif
+
+TKernels SelectKernels() {
+    TKernels k;
+#ifdef GUI_X86_KERNELS
+    k.Name = "sse2";
+    k.BlendRow = BlendRowSSE2;
+    k.BlendRowPremultiplied = BlendRowPremultipliedSSE2;
+    k.FillRow = FillRowSSE2<false>;
+    k.FillRowStream = FillRowSSE2<true>;
+    k.StreamFence = StreamFenceSSE2;
+    k.MaskFillRow = MaskRowSSE2<false>;
+    k.MaskCopyRow = MaskRowSSE2<true>;
+    k.GatherRow = GatherRowScalar;
+    k.LerpRow = LerpRowSSE2;
+    k.ResampleRow = ResampleRowSSE2;
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        k.Name = "avx2";
+        k.BlendRow = BlendRowAVX2;
+        k.BlendRowPremultiplied = BlendRowPremultipliedAVX2;
+        k.FillRow = FillRowAVX2<false>;
+        k.FillRowStream = FillRowAVX2<true>;
+        k.GatherRow = GatherRowAVX2;
+        k.LerpRow = LerpRowAVX2;
+    }
+#else
+    k.Name = "scalar";
+    k.BlendRow = BlendRowScalar;
+    k.BlendRowPremultiplied = BlendRowPremultipliedScalar;
+    k.FillRow = FillRowScalar;
+    k.FillRowStream = FillRowScalar;
+    k.StreamFence = StreamFenceScalar;
+    k.MaskFillRow = MaskRowScalar<false>;
+    k.MaskCopyRow = MaskRowScalar<true>;
+    k.GatherRow = GatherRowScalar;
+    k.LerpRow = LerpRowScalar;
+    k.ResampleRow = ResampleRowScalar;
+#endif
+    return k;
+}
+
+const TKernels s_kernels = SelectKernels();
+
+// Position of the center of each destination pixel in source coordinates, in 16.16 fixed point
+inline int32_t ScalePosition(int i, int32_t step) {
+    return i * step + step / 2 - 0x8000;
+}
+
+} // namespace
+
+void BlendRow(uint32_t *dest, const uint32_t *source, int count) {
+    s_kernels.BlendRow(dest, source, count);
+}
+
+void BlendRowPremultiplied(uint32_t *dest, const uint32_t *source, int count) {
+    s_kernels.BlendRowPremultiplied(dest, source, count);
+}
+
+void FillRow(uint32_t *dest, uint32_t color, int count) {
+    s_kernels.FillRow(dest, color, count);
+}
+
+void FillRect(uint32_t *dest, uint32_t pitch, int width, int height, uint32_t color) {
+    auto stream = (size_t) width * height * sizeof(*dest) >= StreamingFillThreshold;
+    auto fill = stream ? s_kernels.FillRowStream : s_kernels.FillRow;
+
+    // Contiguous rows are filled in one go
+    if (pitch == (uint32_t) width) {
+        fill(dest, color, width * height);
+    } else {
+        for (auto y = 0; y < height; ++y, dest += pitch) {
+            fill(dest, color, width);
+        }
+    }
+
+    if (stream) {
+        s_kernels.StreamFence();
+    }
+}
+
+void MaskFillRow(uint32_t *dest, const uint8_t *mask, int firstBit, uint32_t color, int count) {
+    s_kernels.MaskFillRow(dest, mask, firstBit, color, nullptr, count);
+}
+
+void MaskCopyRow(uint32_t *dest, const uint8_t *mask, int firstBit, const uint32_t *source, int count) {
+    s_kernels.MaskCopyRow(dest, mask, firstBit, 0, source, count);
+}
+
+void ScaleNearest(uint32_t *dest, uint32_t destPitch, int destWidth, int destHeight, const uint32_t *source,
+                  uint32_t sourcePitch, int sourceWidth, int sourceHeight) {
+    // Source pixel under the center of each destination pixel
+    std::vector<int32_t> index(destWidth);
+    for (auto x = 0; x < destWidth; ++x) {
+        index[x] = (int32_t) ((2 * (int64_t) x + 1) * sourceWidth / (2 * destWidth));
+    }
+
+    const uint32_t *previous = nullptr;
+    for (auto y = 0; y < destHeight; ++y, dest += destPitch) {
+        auto sy = (2 * (int64_t) y + 1) * sourceHeight / (2 * destHeight);
+        auto row = source + sy * sourcePitch;
+
+        // When enlarging, consecutive rows often come from the same source row
+        if (row == previous) {
+            memcpy(dest, dest - destPitch, destWidth * sizeof(*dest));
+        } else {
+            s_kernels.GatherRow(dest, row, index.data(), destWidth);
+        }
+        previous = row;
+    }
+}
+
+void ScaleBilinear(uint32_t *dest, uint32_t destPitch, int destWidth, int destHeight, const uint32_t *source,
+                   uint32_t sourcePitch, int sourceWidth, int sourceHeight) {
+    auto xstep = (int32_t) (((int64_t) sourceWidth << 16) / destWidth);
+    auto ystep = (int32_t) (((int64_t) sourceHeight << 16) / destHeight);
+
+    // Left source column and weight of the right column for each destination column
+    std::vector<int32_t> columns(destWidth);
+    std::vector<uint32_t> weights(destWidth);
+    for (auto x = 0; x < destWidth; ++x) {
+        auto pos = ScalePosition(x, xstep);
+        if (pos < 0) {
+            pos = 0;
+        }
+        auto sx = pos >> 16;
+        if (sx >= sourceWidth - 1) {
+            columns[x] = sourceWidth - 1;
+            weights[x] = 0;
+        } else {
+            columns[x] = sx;
+            weights[x] = (pos >> 8) & 0xff;
+        }
+    }
+
+    // One extra pixel so that the right neighbour of the last column can always be read
+    std::vector<uint32_t> row(sourceWidth + 1);
+    for (auto y = 0; y < destHeight; ++y, dest += destPitch) {
+        auto pos = ScalePosition(y, ystep);
+        if (pos < 0) {
+            pos = 0;
+        }
+        auto sy = pos >> 16;
+        auto top = source + (sy < sourceHeight ? sy : sourceHeight - 1) * sourcePitch;
+
+        if (sy >= sourceHeight - 1 || !((pos >> 8) & 0xff)) {
+            memcpy(row.data(), top, sourceWidth * sizeof(*top));
+        } else {
+            s_kernels.LerpRow(row.data(), top, top + sourcePitch, (pos >> 8) & 0xff, sourceWidth);
+        }
+        row[sourceWidth] = row[sourceWidth - 1];
+
+        s_kernels.ResampleRow(dest, row.data(), columns.data(), weights.data(), destWidth);
+    }
+}
+
+void PremultiplyRow(uint32_t *pixels, int count) {
+    for (auto i = 0; i < count; ++i) {
+        auto a = GetAlpha(pixels[i]);
+        if (a != 0xff) {
+            pixels[i] = Premultiply(pixels[i]);
+        }
+    }
+}
+
+const char *GetKernelName() {
+    return s_kernels.Name;
+}
+
+} // namespace pixels
+} // namespace gui
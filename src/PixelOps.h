@@ -0,0 +1,75 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+
+#ifndef __GUI_PIXELOPS_H__
+
+#define __GUI_PIXELOPS_H__
+
+#include <inttypes.h>
+
+namespace gui {
+namespace pixels {
+
+// Row kernels used by the framebuffer. The best implementation for the host CPU
+// (AVX2, SSE2 or plain C++) is selected once at startup.
+
+// Blends count straight-alpha source pixels over the destination pixels.
+void BlendRow(uint32_t *dest, const uint32_t *source, int count);
+
+// Blends count premultiplied-alpha source pixels over the destination pixels.
+void BlendRowPremultiplied(uint32_t *dest, const uint32_t *source, int count);
+
+// Converts count straight-alpha pixels to premultiplied alpha in place.
+void PremultiplyRow(uint32_t *pixels, int count);
+
+// Fills count pixels with color.
+void FillRow(uint32_t *dest, uint32_t color, int count);
+
+// Fills a width x height rectangle with color. pitch is in pixels.
+// Large rectangles are written with non-temporal stores so that
+// they do not evict the working set from the caches.
+void FillRect(uint32_t *dest, uint32_t pitch, int width, int height, uint32_t color);
+
+// Expands count bits of a 1bpp mask (most significant bit first), starting at
+// bit index firstBit. Pixels whose bit is set are filled with color.
+void MaskFillRow(uint32_t *dest, const uint8_t *mask, int firstBit, uint32_t color, int count);
+
+// Same as MaskFillRow, but the pixels whose bit is set are copied from source.
+void MaskCopyRow(uint32_t *dest, const uint8_t *mask, int firstBit, const uint32_t *source, int count);
+
+// Scales a sourceWidth x sourceHeight image to destWidth x destHeight, picking
+// the nearest source pixel. Pitches are in pixels.
+void ScaleNearest(uint32_t *dest, uint32_t destPitch, int destWidth, int destHeight, const uint32_t *source,
+                  uint32_t sourcePitch, int sourceWidth, int sourceHeight);
+
+// Same as ScaleNearest, but interpolates between the four closest source pixels.
+// The source should be premultiplied, otherwise the color of transparent pixels
+// bleeds into their neighbours.
+void ScaleBilinear(uint32_t *dest, uint32_t destPitch, int destWidth, int destHeight, const uint32_t *source,
+                   uint32_t sourcePitch, int sourceWidth, int sourceHeight);
+
+// Returns the name of the instruction set used by the kernels (for diagnostics).
+const char *GetKernelName();
+
+} // namespace pixels
+} // namespace gui
+
+#endif
@@ -114,4 +114,32 @@ TRect TRect::Union(const TRect &a, const TRect &b) {
     return ret;
 }
 
+int TRect::Subtract(const TRect &a, const TRect &b, TRect out[4]) {
+    auto common = b;
+    if (!a.ClipRect(common)) {
+        out[0] = a;
+        return 1;
+    }
+
+    int count = 0;
+
+    // Full width bands above and below the common part
+    if (common.p0.y > a.p0.y) {
+        out[count++] = TRect(a.p0.x, a.p0.y, a.p1.x, common.p0.y - 1);
+    }
+    if (common.p1.y < a.p1.y) {
+        out[count++] = TRect(a.p0.x, common.p1.y + 1, a.p1.x, a.p1.y);
+    }
+
+    // Left and right of the common part
+    if (common.p0.x > a.p0.x) {
+        out[count++] = TRect(a.p0.x, common.p0.y, common.p0.x - 1, common.p1.y);
+    }
+    if (common.p1.x < a.p1.x) {
+        out[count++] = TRect(common.p1.x + 1, common.p0.y, a.p1.x, common.p1.y);
+    }
+
+    return count;
+}
+
 } // namespace gui
@@ -99,7 +99,27 @@ public:
         return x >= p0.x && y >= p0.y && x <= p1.x && y <= p1.y;
     }
 
+    inline bool Contains(const TRect &r) const {
+        return Contains(r.p0.x, r.p0.y) && Contains(r.p1.x, r.p1.y);
+    }
+
+    inline bool operator==(const TRect &r) const {
+        return p0.x == r.p0.x && p0.y == r.p0.y && p1.x == r.p1.x && p1.y == r.p1.y;
+    }
+
+    inline bool operator!=(const TRect &r) const {
+        return !(*this == r);
+    }
+
+    inline TRect Translated(int dx, int dy) const {
+        return TRect(p0.x + dx, p0.y + dy, p1.x + dx, p1.y + dy);
+    }
+
     static TRect Union(const TRect &a, const TRect &b);
+
+    // Stores in out the parts of a that are not covered by b.
+    // Returns the number of rectangles written, at most 4.
+    static int Subtract(const TRect &a, const TRect &b, TRect out[4]);
 };
 } // namespace gui
 
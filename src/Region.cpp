@@ -0,0 +1,204 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+#include <algorithm>
+
+#include "Region.h"
+
+namespace gui {
+
+namespace {
+
+// Horizontal extent of a rectangle in a band, x1 is excluded
+struct TSpan {
+    int x0, x1;
+
+    bool operator==(const TSpan &s) const {
+        return x0 == s.x0 && x1 == s.x1;
+    }
+};
+
+using Spans = std::vector<TSpan>;
+
+// Gets the spans of the rectangles that cover the band [y0, y1].
+// Bands of both regions are split on the same boundaries, so a rectangle
+// either covers the whole band or none of it.
+void GetBandSpans(const CRegion::Rects &rects, int y0, int y1, Spans &spans) {
+    spans.clear();
+    for (const auto &r : rects) {
+        if (r.p0.y > y1) {
+            break;
+        }
+        if (r.p1.y >= y1) {
+            spans.push_back(TSpan{r.p0.x, r.p1.x + 1});
+        }
+    }
+}
+
+void AddSpan(Spans &spans, int x0, int x1) {
+    if (!spans.empty() && spans.back().x1 == x0) {
+        spans.back().x1 = x1;
+    } else {
+        spans.push_back(TSpan{x0, x1});
+    }
+}
+
+} // namespace
+
+void CRegion::Combine(const Rects &a, const Rects &b, EOperation op, Rects &result) {
+    std::vector<int> ys;
+    ys.reserve((a.size() + b.size()) * 2);
+    for (const auto &r : a) {
+        ys.push_back(r.p0.y);
+        ys.push_back(r.p1.y + 1);
+    }
+    for (const auto &r : b) {
+        ys.push_back(r.p0.y);
+        ys.push_back(r.p1.y + 1);
+    }
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+    Spans spansA, spansB, spans, previous;
+    std::vector<int> bounds;
+    size_t previousStart = 0;
+    auto previousEnd = 0;
+
+    result.clear();
+
+    for (size_t k = 0; k + 1 < ys.size(); ++k) {
+        auto y0 = ys[k];
+        auto y1 = ys[k + 1] - 1;
+
+        GetBandSpans(a, y0, y1, spansA);
+        GetBandSpans(b, y0, y1, spansB);
+
+        bounds.clear();
+        for (const auto &s : spansA) {
+            bounds.push_back(s.x0);
+            bounds.push_back(s.x1);
+        }
+        for (const auto &s : spansB) {
+            bounds.push_back(s.x0);
+            bounds.push_back(s.x1);
+        }
+        std::sort(bounds.begin(), bounds.end());
+        bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+        // Sweep the band from left to right, keeping the pieces selected by the operation
+        spans.clear();
+        size_t ia = 0, ib = 0;
+        for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+            auto x = bounds[i];
+            while (ia < spansA.size() && spansA[ia].x1 <= x) {
+                ++ia;
+            }
+            while (ib < spansB.size() && spansB[ib].x1 <= x) {
+                ++ib;
+            }
+
+            auto inA = ia < spansA.size() && spansA[ia].x0 <= x;
+            auto inB = ib < spansB.size() && spansB[ib].x0 <= x;
+
+            bool keep;
+            switch (op) {
+                case UNION:
+                    keep = inA || inB;
+                    break;
+                case INTERSECT:
+                    keep = inA && inB;
+                    break;
+                default:
+                    keep = inA && !inB;
+                    break;
+            }
+
+            if (keep) {
+                AddSpan(spans, x, bounds[i + 1]);
+            }
+        }
+
+        if (spans.empty()) {
+            previous.clear();
+            continue;
+        }
+
+        // Extend the previous band if it is adjacent and has the same spans
+        if (!previous.empty() && previousEnd == y0 - 1 && spans == previous) {
+            for (auto i = previousStart; i < result.size(); ++i) {
+                result[i].p1.y = y1;
+            }
+        } else {
+            previousStart = result.size();
+            for (const auto &s : spans) {
+                result.push_back(TRect(s.x0, y0, s.x1 - 1, y1));
+            }
+            previous.swap(spans);
+        }
+        previousEnd = y1;
+    }
+}
+
+void CRegion::Apply(const CRegion &r, EOperation op) {
+    if (r.Empty()) {
+        if (op == INTERSECT) {
+            m_rects.clear();
+        }
+        return;
+    }
+
+    if (Empty()) {
+        if (op == UNION) {
+            m_rects = r.m_rects;
+        }
+        return;
+    }
+
+    Rects result;
+    Combine(m_rects, r.m_rects, op, result);
+    m_rects.swap(result);
+}
+
+TRect CRegion::GetBounds() const {
+    assert(!Empty());
+    auto ret = m_rects[0];
+    for (const auto &r : m_rects) {
+        ret = TRect::Union(ret, r);
+    }
+    return ret;
+}
+
+bool CRegion::Intersects(const TRect &r) const {
+    for (const auto &rect : m_rects) {
+        auto c = r;
+        if (rect.ClipRect(c)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CRegion::Translate(int dx, int dy) {
+    for (auto &r : m_rects) {
+        r = r.Translated(dx, dy);
+    }
+}
+
+} // namespace gui
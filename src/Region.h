@@ -0,0 +1,93 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+#ifndef __GUI_REGION_H__
+
+#define __GUI_REGION_H__
+
+#include <vector>
+
+#include "Rect.h"
+
+namespace gui {
+
+// A set of pixels, stored as non-overlapping rectangles sorted in bands.
+// All the rectangles of a band have the same vertical extent, and are
+// sorted from left to right. Adjacent bands with the same horizontal
+// extents are merged.
+class CRegion {
+public:
+    using Rects = std::vector<TRect>;
+
+private:
+    Rects m_rects;
+
+    enum EOperation { UNION, INTERSECT, SUBTRACT };
+
+    static void Combine(const Rects &a, const Rects &b, EOperation op, Rects &result);
+
+    void Apply(const CRegion &r, EOperation op);
+
+public:
+    CRegion() {
+    }
+
+    CRegion(const TRect &r) {
+        if (r.Valid()) {
+            m_rects.push_back(r);
+        }
+    }
+
+    bool Empty() const {
+        return m_rects.empty();
+    }
+
+    void Clear() {
+        m_rects.clear();
+    }
+
+    const Rects &GetRects() const {
+        return m_rects;
+    }
+
+    // Returns the smallest rectangle that contains the region.
+    // The region must not be empty.
+    TRect GetBounds() const;
+
+    bool Intersects(const TRect &r) const;
+
+    void Union(const CRegion &r) {
+        Apply(r, UNION);
+    }
+
+    void Intersect(const CRegion &r) {
+        Apply(r, INTERSECT);
+    }
+
+    void Subtract(const CRegion &r) {
+        Apply(r, SUBTRACT);
+    }
+
+    void Translate(int dx, int dy);
+};
+
+} // namespace gui
+
+#endif
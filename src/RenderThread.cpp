@@ -0,0 +1,96 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+#include <assert.h>
+
+#include "RenderThread.h"
+
+namespace gui {
+
+CRenderThread::CRenderThread(const std::function<void()> &onDone) : m_stop(false), m_onDone(onDone) {
+    m_thread = std::thread(&CRenderThread::ThreadMain, this);
+}
+
+CRenderThread::~CRenderThread() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+void CRenderThread::ThreadMain() {
+    std::unique_lock<std::mutex> lock(m_lock);
+    while (true) {
+        m_wake.wait(lock, [this]() { return m_stop || m_list; });
+        if (m_stop) {
+            return;
+        }
+
+        auto list = m_list;
+        auto target = m_target;
+        lock.unlock();
+
+        if (target) {
+            list->Replay(*target.get());
+        }
+
+        lock.lock();
+        m_list = nullptr;
+        auto onDone = m_onDone;
+        lock.unlock();
+
+        // Waiters are woken once the lock is released, and the callback may use this object
+        m_idle.notify_all();
+        if (onDone) {
+            onDone();
+        }
+
+        lock.lock();
+    }
+}
+
+void CRenderThread::SetTarget(const CFrameBufferPtr &target) {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_idle.wait(lock, [this]() { return !m_list; });
+    m_target = target;
+}
+
+bool CRenderThread::IsIdle() {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return !m_list;
+}
+
+void CRenderThread::Wait() {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_idle.wait(lock, [this]() { return !m_list; });
+}
+
+void CRenderThread::Submit(const CDisplayListPtr &list) {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        assert(!m_list);
+        m_list = list;
+    }
+    m_wake.notify_one();
+}
+
+} // namespace gui
@@ -0,0 +1,83 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+#ifndef __GUI_RENDERTHREAD_H__
+
+#define __GUI_RENDERTHREAD_H__
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "DisplayList.h"
+#include "Framebuffer.h"
+
+namespace gui {
+
+class CRenderThread;
+using CRenderThreadPtr = std::shared_ptr<CRenderThread>;
+
+// Replays display lists into a framebuffer on a thread of its own,
+// one at a time. The framebuffer must not be accessed while a list
+// is being replayed.
+class CRenderThread {
+private:
+    std::thread m_thread;
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+
+    CFrameBufferPtr m_target;
+    CDisplayListPtr m_list;
+    bool m_stop;
+
+    // Called on the render thread once a list was replayed. It runs without
+    // the lock held, so it may call the other methods, even Submit.
+    std::function<void()> m_onDone;
+
+    CRenderThread(const std::function<void()> &onDone);
+
+    void ThreadMain();
+
+public:
+    ~CRenderThread();
+
+    static CRenderThreadPtr Create(const std::function<void()> &onDone) {
+        return CRenderThreadPtr(new CRenderThread(onDone));
+    }
+
+    // Waits for the current list to be replayed before switching
+    void SetTarget(const CFrameBufferPtr &target);
+
+    // Returns true if no list is being replayed
+    bool IsIdle();
+
+    // Waits until no list is being replayed
+    void Wait();
+
+    // Must only be called when the thread is idle
+    void Submit(const CDisplayListPtr &list);
+};
+
+} // namespace gui
+
+#endif
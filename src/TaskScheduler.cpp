@@ -0,0 +1,164 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+#include "TaskScheduler.h"
+
+namespace gui {
+
+// Scheduler and queue that the current thread works for, if it is a worker
+static thread_local const CTaskScheduler *t_scheduler = nullptr;
+static thread_local int t_queueIndex = -1;
+
+void CTaskGroup::Run(std::function<void()> task) {
+    ++m_pending;
+    m_scheduler.Push(CTaskScheduler::TTask{std::move(task), this});
+}
+
+void CTaskGroup::Wait() {
+    auto index = m_scheduler.GetQueueIndex();
+    while (m_pending > 0) {
+        if (m_scheduler.RunOne(index)) {
+            continue;
+        }
+
+        // Nothing to help with, sleep until the group is done or more tasks are queued
+        std::unique_lock<std::mutex> lock(m_scheduler.m_sleepLock);
+        m_scheduler.m_wake.wait(lock, [this]() { return m_pending == 0 || m_scheduler.m_queued > 0; });
+    }
+}
+
+CTaskScheduler::CTaskScheduler(unsigned workers) : m_queued(0), m_stop(false) {
+    if (workers == 0) {
+        workers = std::thread::hardware_concurrency();
+        workers = workers ? workers : 1;
+    }
+
+    for (auto i = 0u; i <= workers; ++i) {
+        m_queues.emplace_back(new TQueue());
+    }
+
+    for (auto i = 0u; i < workers; ++i) {
+        m_workers.emplace_back(&CTaskScheduler::WorkerMain, this, i);
+    }
+}
+
+CTaskScheduler::~CTaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepLock);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (auto &worker : m_workers) {
+        worker.join();
+    }
+}
+
+int CTaskScheduler::GetQueueIndex() const {
+    if (t_scheduler == this) {
+        return t_queueIndex;
+    }
+    return m_workers.size();
+}
+
+void CTaskScheduler::Push(TTask task) {
+    auto &queue = *m_queues[GetQueueIndex()].get();
+    {
+        std::lock_guard<std::mutex> lock(queue.lock);
+        queue.tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_sleepLock);
+        ++m_queued;
+    }
+    m_wake.notify_one();
+}
+
+bool CTaskScheduler::Pop(int index, TTask &task) {
+    // The newest task of our own queue is the most likely to have its data in the cache
+    auto &own = *m_queues[index].get();
+    {
+        std::lock_guard<std::mutex> lock(own.lock);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // The oldest tasks of the others are usually the largest ones
+    auto count = m_queues.size();
+    for (auto i = 1u; i < count; ++i) {
+        auto &victim = *m_queues[(index + i) % count].get();
+        std::lock_guard<std::mutex> lock(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool CTaskScheduler::RunOne(int index) {
+    if (m_queued == 0) {
+        return false;
+    }
+
+    TTask task;
+    if (!Pop(index, task)) {
+        return false;
+    }
+
+    --m_queued;
+    task.func();
+
+    // The group may be destroyed as soon as its waiter sees the last task done,
+    // so it is not touched after that
+    if (--task.group->m_pending == 0) {
+        // Taking the lock makes sure the waiter is either asleep or about to see the count
+        {
+            std::lock_guard<std::mutex> lock(m_sleepLock);
+        }
+        m_wake.notify_all();
+    }
+    return true;
+}
+
+void CTaskScheduler::WorkerMain(int index) {
+    t_scheduler = this;
+    t_queueIndex = index;
+
+    while (true) {
+        if (RunOne(index)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepLock);
+        m_wake.wait(lock, [this]() { return m_stop || m_queued > 0; });
+        if (m_stop) {
+            return;
+        }
+    }
+}
+
+} // namespace gui
@@ -0,0 +1,132 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+#ifndef __GUI_TASKSCHEDULER_H__
+
+#define __GUI_TASKSCHEDULER_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gui {
+
+class CTaskScheduler;
+using CTaskSchedulerPtr = std::shared_ptr<CTaskScheduler>;
+
+// Set of tasks that can be waited for together
+class CTaskGroup {
+private:
+    friend class CTaskScheduler;
+
+    CTaskScheduler &m_scheduler;
+    std::atomic<size_t> m_pending;
+
+public:
+    CTaskGroup(CTaskScheduler &scheduler) : m_scheduler(scheduler), m_pending(0) {
+    }
+
+    CTaskGroup(const CTaskGroup &) = delete;
+    CTaskGroup &operator=(const CTaskGroup &) = delete;
+
+    ~CTaskGroup() {
+        Wait();
+    }
+
+    void Run(std::function<void()> task);
+
+    // Returns once all the tasks of the group are done. The calling
+    // thread runs pending tasks in the meantime, so groups may be nested,
+    // and sleeps when there is none left to run.
+    void Wait();
+};
+
+// Runs tasks on a fixed set of worker threads. Each worker has its own
+// queue of tasks, takes the newest task from it and steals the oldest
+// ones from the other workers when it runs out.
+class CTaskScheduler {
+private:
+    friend class CTaskGroup;
+
+    struct TTask {
+        std::function<void()> func;
+        CTaskGroup *group;
+    };
+
+    struct TQueue {
+        std::mutex lock;
+        std::deque<TTask> tasks;
+    };
+
+    // One queue per worker, and a last one for the tasks of other threads
+    std::vector<std::unique_ptr<TQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+
+    // Idle workers and threads waiting for a group sleep on m_wake until
+    // tasks are queued or a group is done
+    std::atomic<size_t> m_queued;
+    std::mutex m_sleepLock;
+    std::condition_variable m_wake;
+    bool m_stop;
+
+    CTaskScheduler(unsigned workers);
+
+    int GetQueueIndex() const;
+    void Push(TTask task);
+    bool Pop(int index, TTask &task);
+    bool RunOne(int index);
+    void WorkerMain(int index);
+
+public:
+    ~CTaskScheduler();
+
+    // Uses one worker per core when workers is 0
+    static CTaskSchedulerPtr Create(unsigned workers = 0) {
+        return CTaskSchedulerPtr(new CTaskScheduler(workers));
+    }
+
+    unsigned GetWorkerCount() const {
+        return m_workers.size();
+    }
+
+    // Calls func(begin, end) on consecutive ranges of at most grain items
+    // covering [begin, end), and returns once all of them are done.
+    template <typename Func> void ParallelFor(size_t begin, size_t end, size_t grain, Func func) {
+        if (grain == 0) {
+            grain = 1;
+        }
+
+        CTaskGroup group(*this);
+        for (auto b = begin; b < end; b += grain) {
+            auto e = end - b > grain ? b + grain : end;
+            group.Run([&func, b, e]() { func(b, e); });
+        }
+        group.Wait();
+    }
+};
+
+} // namespace gui
+
+#endif
@@ -18,6 +18,8 @@
 /// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 /// SOFTWARE.
 
+#include <algorithm>
+#include <dirent.h>
 #include <fstream>
 
 #include "Utils.h"
@@ -43,5 +45,24 @@ std::unique_ptr<uint8_t[]> ReadFile(const std::string &fileName, size_t &size) {
     return data;
 }
 
+std::vector<std::string> ListFiles(const std::string &directory, const std::string &suffix) {
+    std::vector<std::string> ret;
+    auto dir = opendir(directory.c_str());
+    if (!dir) {
+        return ret;
+    }
+
+    while (auto entry = readdir(dir)) {
+        auto name = std::string(entry->d_name);
+        if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            ret.push_back(directory + "/" + name);
+        }
+    }
+    closedir(dir);
+
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
 } // namespace utils
 } // namespace gui
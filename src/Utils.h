@@ -24,11 +24,16 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace gui {
 namespace utils {
 
 std::unique_ptr<uint8_t[]> ReadFile(const std::string &fileName, size_t &size);
+
+// Returns the paths of the files of directory whose name ends with suffix,
+// sorted by name. Returns an empty list if the directory cannot be read.
+std::vector<std::string> ListFiles(const std::string &directory, const std::string &suffix);
 }
 } // namespace gui
 
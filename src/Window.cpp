@@ -19,17 +19,145 @@
 /// SOFTWARE.
 
 #include "Window.h"
+#include "BackingStore.h"
+#include "DisplayList.h"
 #include "Framebuffer.h"
+#include "Region.h"
 
 namespace gui {
 
+bool CWindow::s_retainedMode = true;
+
 void CWindow::GetAbsoluteCoords(int &x, int &y) const {
-    x = 0;
-    y = 0;
-    for (auto w = this; w != nullptr; w = w->GetParent().get()) {
-        x += w->GetX();
-        y += w->GetY();
+    if (!m_absolutePositionValid) {
+        m_absolutePosition = m_rect.p0;
+        if (m_parent) {
+            int px, py;
+            m_parent->GetAbsoluteCoords(px, py);
+            m_absolutePosition.x += px;
+            m_absolutePosition.y += py;
+        }
+        m_absolutePositionValid = true;
+    }
+
+    x = m_absolutePosition.x;
+    y = m_absolutePosition.y;
+}
+
+void CWindow::InvalidateAbsolutePosition() {
+    // The position of a child is only cached after the one of its parent
+    if (!m_absolutePositionValid) {
+        return;
+    }
+
+    m_absolutePositionValid = false;
+    for (auto &child : m_children) {
+        child->InvalidateAbsolutePosition();
+    }
+}
+
+void CWindow::SetDirty(bool b) {
+    m_dirty = b;
+    if (b) {
+        m_displayList = nullptr;
+        SetParentsDirty();
+        AddDamage(GetAbsoluteRect());
+    }
+}
+
+void CWindow::SetParentsDirty() {
+    // A window with the flag set already has it set on all its parents
+    for (auto w = m_parent.get(); w && !w->m_dirtyChildren; w = w->m_parent.get()) {
+        w->m_dirtyChildren = true;
+    }
+}
+
+void CWindow::ClearDirty() {
+    m_dirty = false;
+    if (!m_dirtyChildren) {
+        return;
+    }
+
+    for (auto &child : m_children) {
+        if (child->m_dirty || child->m_dirtyChildren) {
+            child->ClearDirty();
+        }
     }
+    m_dirtyChildren = false;
+}
+
+void CWindow::AddDamage(const TRect &r) {
+    if (m_backingStore) {
+        int x, y;
+        GetAbsoluteCoords(x, y);
+        m_backingStore->AddDamage(r.Translated(-x, -y));
+    }
+
+    if (m_parent) {
+        m_parent->AddDamage(r);
+    }
+}
+
+void CWindow::OnChildMoved(CWindow &child, TRect oldRect) {
+    int x, y;
+    GetAbsoluteCoords(x, y);
+    AddDamage(oldRect.Translated(x, y));
+    AddDamage(child.GetRect().Translated(x, y));
+}
+
+void CWindow::SetBackingStore(bool b) {
+    m_useBackingStore = b;
+    m_backingStoreRefused = false;
+    if (!b) {
+        m_backingStore = nullptr;
+    }
+}
+
+CBackingStore *CWindow::AllocateBackingStore() {
+    if (!m_useBackingStore || !IsOpaque()) {
+        return nullptr;
+    }
+
+    // The store is rendered again from scratch when the window is resized
+    if (m_backingStore && (m_backingStore->GetWidth() != GetWidth() || m_backingStore->GetHeight() != GetHeight())) {
+        m_backingStore = nullptr;
+    }
+
+    if (!m_backingStore) {
+        auto generation = CBackingStore::GetLimitGeneration();
+        if (m_backingStoreRefused && m_refusedGeneration == generation) {
+            return nullptr;
+        }
+
+        m_backingStore = CBackingStore::Create(GetWidth(), GetHeight());
+        m_backingStoreRefused = !m_backingStore;
+        m_refusedGeneration = generation;
+    }
+
+    return m_backingStore.get();
+}
+
+CBackingStore *CWindow::GetBackingStore() const {
+    if (!m_useBackingStore || !IsOpaque() || !m_backingStore) {
+        return nullptr;
+    }
+
+    // A store of the wrong size is replaced by the next AllocateBackingStore
+    if (m_backingStore->GetWidth() != GetWidth() || m_backingStore->GetHeight() != GetHeight()) {
+        return nullptr;
+    }
+
+    return m_backingStore.get();
+}
+
+void CWindow::RecordDisplayList() {
+    if (!s_retainedMode || m_displayList) {
+        return;
+    }
+
+    CRecordingFrameBuffer recording(GetWidth(), GetHeight());
+    Draw(recording);
+    m_displayList = recording.TakeDisplayList();
 }
 
 void CWindow::Draw(IFrameBuffer &fb) const {
@@ -43,7 +171,14 @@ void CWindow::SetFocus() {
         return;
     }
 
-    SetDirty(true);
+    // Raising a window that is already on top does not change the screen
+    if (HasFocus()) {
+        m_parent->SetFocus();
+        return;
+    }
+
+    // The contents of the window do not change, only what is visible of it
+    m_parent->AddDamage(GetAbsoluteRect());
     auto oldParent = m_parent;
     if (m_parent->FocusChild(this)) {
         oldParent->SetFocus();
@@ -69,33 +204,149 @@ CWindowPtr WindowFromPoint(const CWindowPtr &root, int x, int y) {
     return root;
 }
 
-bool DrawWindow(IFrameBuffer &fb, TRect client, CWindow &wnd, bool parentDirty) {
+// Paints wnd from its display list if it has one
+static void DrawContents(const CWindow &wnd, IFrameBuffer &fb) {
+    auto list = wnd.GetDisplayList();
+    if (list) {
+        list->Draw(fb);
+    } else {
+        wnd.Draw(fb);
+    }
+}
+
+
+// Draws wnd with its top left corner at origin in fb, limited to the client region of fb.
+// Windows with a backing store are copied from it when composite is set.
+// Subtrees outside client are not visited. Moves and focus changes damage windows
+// that are not dirty, so client rather than the dirty flags decides what is drawn.
+static bool DrawTree(CFrameBuffer &fb, const CRegion &client, CWindow &wnd, TPoint origin, bool parentDirty,
+                     bool composite) {
     if (!wnd.Visible()) {
         return false;
     }
 
-    int x, y;
-    wnd.GetAbsoluteCoords(x, y);
+    auto thisRect = TRect(origin.x, origin.y, origin.x + wnd.GetWidth() - 1, origin.y + wnd.GetHeight() - 1);
+    if (!client.Intersects(thisRect)) {
+        return false;
+    }
 
-    CClippedFrameBuffer cfb(fb, client);
-    CTranslatedFrameBuffer tfb(cfb, TPoint(x, y));
+    auto region = client;
+    region.Intersect(thisRect);
+    if (region.Empty()) {
+        return false;
+    }
+
+    // Stores that were not brought up to date by PrepareDrawWindow are not used
+    auto store = composite ? wnd.GetBackingStore() : nullptr;
+    if (store && store->GetDamage().Empty()) {
+        auto &storeFb = store->GetFrameBuffer();
+        for (const auto &r : region.GetRects()) {
+            fb.CopyPixels(storeFb, r.Translated(-origin.x, -origin.y), r.p0);
+        }
+        return true;
+    }
+
+    // Visible part of each child, from the topmost one down.
+    // Opaque children hide what is below them, including this window.
+    const auto &children = wnd.GetChildren();
+    std::vector<CRegion> childRegions(children.size());
+    CRegion covered;
+    auto i = children.size();
+    for (auto it = children.rbegin(); it != children.rend(); ++it) {
+        auto &child = *it;
+        auto &childRegion = childRegions[--i];
+        if (!child->Visible()) {
+            continue;
+        }
+
+        auto childRect = child->GetRect().Translated(origin.x, origin.y);
+        if (!region.Intersects(childRect)) {
+            continue;
+        }
+
+        childRegion = region;
+        childRegion.Intersect(childRect);
+        childRegion.Subtract(covered);
+        if (child->IsOpaque()) {
+            covered.Union(childRect);
+        }
+    }
 
     auto dirty = wnd.IsDirty() || parentDirty;
     if (dirty) {
-        wnd.Draw(tfb);
-    }
+        region.Subtract(covered);
 
-    auto thisRect = TRect(x, y, x + wnd.GetWidth() - 1, y + wnd.GetHeight() - 1);
-    if (!client.ClipRect(thisRect)) {
-        return false;
+        // Primitives of a window that is entirely visible need no clipping.
+        // Display lists are clipped to the window when they are recorded.
+        auto inside = wnd.GetDisplayList() || wnd.DrawsInsideBounds();
+        for (const auto &r : region.GetRects()) {
+            if (r == thisRect && fb.GetRect().Contains(r) && inside) {
+                CFrameBufferView<false, true> view(fb, r, origin);
+                DrawContents(wnd, view);
+            } else {
+                CFrameBufferView<true, true> view(fb, r, origin);
+                DrawContents(wnd, view);
+            }
+        }
     }
 
-    for (auto child : wnd.GetChildren()) {
-        dirty |= DrawWindow(fb, thisRect, *child.get(), dirty);
+    i = 0;
+    for (auto &child : children) {
+        const auto &childRegion = childRegions[i++];
+        if (!childRegion.Empty()) {
+            auto childOrigin = TPoint(origin.x + child->GetX(), origin.y + child->GetY());
+            dirty |= DrawTree(fb, childRegion, *child.get(), childOrigin, dirty, true);
+        }
     }
 
-    wnd.SetDirty(false);
     return dirty;
 }
 
+// Settles the backing stores and display lists that DrawTree uses for the same
+// arguments. Windows with a store are not prepared further when composite is set,
+// their children are prepared when the store is redrawn.
+static void PrepareTree(const CRegion &client, CWindow &wnd, TPoint origin, bool composite) {
+    if (!wnd.Visible()) {
+        return;
+    }
+
+    auto thisRect = TRect(origin.x, origin.y, origin.x + wnd.GetWidth() - 1, origin.y + wnd.GetHeight() - 1);
+    if (!client.Intersects(thisRect)) {
+        return;
+    }
+
+    auto store = composite ? wnd.AllocateBackingStore() : nullptr;
+    if (store) {
+        // Redraws the damaged part of the store
+        if (!store->GetDamage().Empty()) {
+            auto damage = store->GetDamage();
+            store->ClearDamage();
+            PrepareTree(damage, wnd, TPoint(0, 0), false);
+            DrawTree(store->GetFrameBuffer(), damage, wnd, TPoint(0, 0), true, false);
+        }
+        return;
+    }
+
+    wnd.RecordDisplayList();
+    for (auto &child : wnd.GetChildren()) {
+        PrepareTree(client, *child.get(), TPoint(origin.x + child->GetX(), origin.y + child->GetY()), true);
+    }
+}
+
+void PrepareDrawWindow(const CRegion &client, CWindow &wnd) {
+    int x, y;
+    wnd.GetAbsoluteCoords(x, y);
+    PrepareTree(client, wnd, TPoint(x, y), true);
+}
+
+bool DrawWindow(CFrameBuffer &fb, TRect client, CWindow &wnd, bool parentDirty) {
+    return DrawWindow(fb, CRegion(client), wnd, parentDirty);
+}
+
+bool DrawWindow(CFrameBuffer &fb, const CRegion &client, CWindow &wnd, bool parentDirty) {
+    int x, y;
+    wnd.GetAbsoluteCoords(x, y);
+    return DrawTree(fb, client, wnd, TPoint(x, y), parentDirty, true);
+}
+
 } // namespace gui
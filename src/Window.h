@@ -38,6 +38,9 @@ class CWindow;
 class CFrameBuffer;
 class IFrameBuffer;
 class CWindowManager;
+class CRegion;
+class CBackingStore;
+class CDisplayList;
 using CWindowPtr = std::shared_ptr<CWindow>;
 
 class CWindow : public CMouseEventHandlers, public std::enable_shared_from_this<CWindow> {
@@ -59,7 +62,27 @@ protected:
     uint32_t m_color;
     bool m_interceptChildEvents;
     bool m_dirty;
+    // Set when a window below this one is dirty, so that ClearDirty skips clean subtrees
+    bool m_dirtyChildren;
     ECursorType m_cursor;
+    bool m_useBackingStore;
+    std::shared_ptr<CBackingStore> m_backingStore;
+
+    // Set when the store could not be allocated, until the window is
+    // resized or the limit of CBackingStore changes from m_refusedGeneration
+    bool m_backingStoreRefused;
+    unsigned m_refusedGeneration;
+
+    // What Draw paints, recorded in window coordinates on first use.
+    // Discarded when the window becomes dirty.
+    std::shared_ptr<CDisplayList> m_displayList;
+    static bool s_retainedMode;
+
+    // Position of the window on the screen, computed on first use
+    mutable TPoint m_absolutePosition;
+    mutable bool m_absolutePositionValid;
+
+    void InvalidateAbsolutePosition();
 
 public:
     CWindow(const this_is_private &p, TRect r) : m_rect(r) {
@@ -68,7 +91,12 @@ public:
         m_color = 0;
         m_interceptChildEvents = false;
         m_dirty = true;
+        m_dirtyChildren = false;
         m_cursor = CURSOR_ARROW;
+        m_useBackingStore = false;
+        m_backingStoreRefused = false;
+        m_refusedGeneration = 0;
+        m_absolutePositionValid = false;
     }
 
 protected:
@@ -89,6 +117,8 @@ protected:
         return true;
     }
 
+    void SetParentsDirty();
+
     virtual bool RemoveChild(CWindow *child) {
         for (auto it = m_children.begin(); it != m_children.end(); ++it) {
             auto w = *it;
@@ -100,6 +130,14 @@ protected:
         return false;
     }
 
+    // Called when child moved from oldRect without being resized.
+    // By default, the child is repainted at both positions.
+    virtual void OnChildMoved(CWindow &child, TRect oldRect);
+
+    // Records that the screen area r (in absolute coordinates) must be repainted.
+    // The root window collects the damage of the whole tree.
+    virtual void AddDamage(const TRect &r);
+
     bool HasChild(CWindow *child) {
         for (auto it = m_children.begin(); it != m_children.end(); ++it) {
             auto w = *it;
@@ -119,11 +157,8 @@ public:
     void SetVisible(bool v) {
         bool redraw = v != m_visible;
         m_visible = v;
-        if (redraw) {
-            SetDirty(true);
-            if (m_parent) {
-                m_parent->SetDirty(true);
-            }
+        if (redraw && m_parent) {
+            m_parent->AddDamage(GetAbsoluteRect());
         }
     }
 
@@ -173,10 +208,28 @@ public:
 
     virtual void SetRect(TRect r) {
         assert(r.Valid());
+        if (r == m_rect) {
+            return;
+        }
+
+        auto oldRect = m_rect;
+        auto oldBounds = GetAbsoluteRect();
         m_rect = r;
-        if (m_parent) {
-            m_parent->SetDirty(true);
+        if (oldRect.p0.x != r.p0.x || oldRect.p0.y != r.p0.y) {
+            InvalidateAbsolutePosition();
+        }
+
+        // The content of a window that only changes position stays the same,
+        // the parent decides how to update the screen.
+        if (oldRect.Width() == r.Width() && oldRect.Height() == r.Height()) {
+            if (m_parent) {
+                m_parent->OnChildMoved(*this, oldRect);
+            }
+            return;
         }
+
+        m_backingStoreRefused = false;
+        AddDamage(oldBounds);
         SetDirty(true);
     }
 
@@ -184,8 +237,49 @@ public:
         return m_dirty;
     }
 
-    void SetDirty(bool b) {
-        m_dirty = b;
+    bool HasDirtyChildren() const {
+        return m_dirtyChildren;
+    }
+
+    // Marking a window dirty damages its bounds
+    void SetDirty(bool b);
+
+    // Marks this window and all the windows below it clean.
+    // Subtrees without dirty windows are not visited.
+    void ClearDirty();
+
+    // Keeps the rendered contents of the window and its children in an offscreen
+    // framebuffer, so that moving or exposing the window is a copy.
+    // Only opaque windows can use a backing store.
+    void SetBackingStore(bool b);
+
+    // Returns the backing store of the window, allocating it if needed.
+    // Returns the backing store of the window, allocating it if needed.
+    // Returns nullptr if the window does not use one, or if the memory
+    // limit for backing stores is reached. A refused store is not asked
+    // for again until the window is resized or the limit changes.
+    CBackingStore *AllocateBackingStore();
+
+    // Same as AllocateBackingStore, but never allocates, so that it can be
+    // called while the tree is drawn on several threads
+    CBackingStore *GetBackingStore() const;
+
+    // In retained mode, the output of Draw is recorded once and replayed until
+    // the window is marked dirty. Moving a window does not call Draw again.
+    static void SetRetainedMode(bool b) {
+        s_retainedMode = b;
+    }
+
+    static bool GetRetainedMode() {
+        return s_retainedMode;
+    }
+
+    // Records the output of Draw if it is not recorded yet and retained mode is on
+    void RecordDisplayList();
+
+    // Returns nullptr if Draw must be called to paint the window
+    const CDisplayList *GetDisplayList() const {
+        return s_retainedMode ? m_displayList.get() : nullptr;
     }
 
     const Children &GetChildren() const {
@@ -198,8 +292,29 @@ public:
 
     void GetAbsoluteCoords(int &x, int &y) const;
 
+    TRect GetAbsoluteRect() const {
+        int x, y;
+        GetAbsoluteCoords(x, y);
+        return TRect(x, y, x + GetWidth() - 1, y + GetHeight() - 1);
+    }
+
     virtual void Draw(IFrameBuffer &fb) const;
 
+    // Returns true if Draw, together with the children that are always shown,
+    // paints every pixel of the window. Whatever is behind an opaque window
+    // is not drawn. Windows that override Draw must override this too if
+    // they leave pixels untouched.
+    virtual bool IsOpaque() const {
+        return true;
+    }
+
+    // Returns true if Draw only touches pixels inside the window. Such windows
+    // are drawn without clipping when they are entirely visible. Windows that
+    // override Draw must override this too if they can draw outside.
+    virtual bool DrawsInsideBounds() const {
+        return true;
+    }
+
     virtual void SetFocus();
 
     bool HasFocus() const {
@@ -214,13 +329,26 @@ public:
         assert(!child->m_parent);
         assert(!HasChild(child.get()));
         child->m_parent = shared_from_this();
+        child->InvalidateAbsolutePosition();
         m_children.push_back(child);
+        if (child->m_dirty || child->m_dirtyChildren) {
+            child->SetParentsDirty();
+        }
         SetDirty(true);
     }
 };
 
 CWindowPtr WindowFromPoint(const CWindowPtr &root, int x, int y);
-bool DrawWindow(IFrameBuffer &fb, TRect client, CWindow &wnd, bool parentDirty);
+
+// Allocates and redraws the backing stores, and records the display lists of the
+// windows that intersect client. Call this before DrawWindow, which only uses them.
+void PrepareDrawWindow(const CRegion &client, CWindow &wnd);
+
+// Draws the part of wnd and its children that lies in client. The windows are
+// not modified, not even their dirty flags, which the caller resets with
+// CWindow::ClearDirty. Several threads may draw different parts of the same tree.
+bool DrawWindow(CFrameBuffer &fb, TRect client, CWindow &wnd, bool parentDirty);
+bool DrawWindow(CFrameBuffer &fb, const CRegion &client, CWindow &wnd, bool parentDirty);
 
 } // namespace gui
 
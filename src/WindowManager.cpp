@@ -20,6 +20,8 @@
 
 #include "WindowManager.h"
 #include "Cursor.h"
+#include "ImageLoader.h"
+#include "Utils.h"
 
 namespace gui {
 
@@ -87,75 +89,243 @@ void CWindowManager::OnButtonUpHandler(const MouseState &state, MouseButton b) {
     propagateEvent(wnd, [&](CWindowPtr wnd) -> void { wnd->OnMouseButtonUpHandler(state, b); });
 }
 
-bool CWindowManager::LoadCursors() {
-    std::unordered_map<ECursorType, std::string> cursors = {{CURSOR_ARROW, "arrow.cur"},
-                                                            {CURSOR_SIZE_NE, "size2_ne.cur"},
-                                                            {CURSOR_SIZE_NS, "size2_ns.cur"},
-                                                            {CURSOR_SIZE_NW, "size2_nw.cur"},
-                                                            {CURSOR_SIZE_WE, "size2_we.cur"}};
-
-    for (auto it : cursors) {
-        auto cursorPath = m_resourcePath + "/cursors/" + it.second;
-        auto cursor = CCursor::Create(cursorPath);
-        if (!cursor) {
-            printf("Could not load %s\n", cursorPath.c_str());
-            return false;
-        }
-        m_cursors[it.first] = cursor;
+// Font, cursors and icons do not depend on each other. They are read and
+// decoded in parallel, and the results are checked once all of them are done.
+bool CWindowManager::LoadResources() {
+    static const std::pair<ECursorType, const char *> cursorFiles[] = {{CURSOR_ARROW, "arrow.cur"},
+                                                                       {CURSOR_SIZE_NE, "size2_ne.cur"},
+                                                                       {CURSOR_SIZE_NS, "size2_ns.cur"},
+                                                                       {CURSOR_SIZE_NW, "size2_nw.cur"},
+                                                                       {CURSOR_SIZE_WE, "size2_we.cur"}};
+    static const size_t cursorCount = sizeof(cursorFiles) / sizeof(cursorFiles[0]);
+
+    auto egaFont = m_resourcePath + "/fonts/ega.cpi";
+    std::shared_ptr<font::CCPIFont> font;
+
+    std::string cursorPaths[cursorCount];
+    std::shared_ptr<CCursor> cursors[cursorCount];
+
+    // Icons are kept in the image cache, controls that show them get the decoded image
+    auto iconPaths = utils::ListFiles(m_resourcePath + "/icons", ".png");
+    std::vector<CFrameBufferPtr> icons(iconPaths.size());
+
+    CTaskGroup group(*m_scheduler);
+    group.Run([&]() { font = font::CCPIFont::Create(egaFont); });
+
+    for (size_t i = 0; i < cursorCount; ++i) {
+        cursorPaths[i] = m_resourcePath + "/cursors/" + cursorFiles[i].second;
+        group.Run([&, i]() { cursors[i] = CCursor::Create(cursorPaths[i]); });
     }
 
-    m_cursor = m_cursors[CURSOR_ARROW];
-    return true;
-}
+    for (size_t i = 0; i < iconPaths.size(); ++i) {
+        group.Run([&, i]() { icons[i] = LoadCachedImage(iconPaths[i]); });
+    }
 
-bool CWindowManager::LoadResources() {
-    auto egaFont = m_resourcePath + "/fonts/ega.cpi";
-    m_font = font::CCPIFont::Create(egaFont);
-    if (!m_font) {
+    group.Wait();
+
+    if (!font) {
         printf("Could not read font %s\n", egaFont.c_str());
         return false;
     }
 
+    m_font = font;
     auto fontNames = m_font->GetFonts();
     for (auto &name : fontNames) {
         printf("Available font %s\n", name.c_str());
     }
 
-    if (!LoadCursors()) {
-        return false;
+    for (size_t i = 0; i < cursorCount; ++i) {
+        if (!cursors[i]) {
+            printf("Could not load %s\n", cursorPaths[i].c_str());
+            return false;
+        }
+        m_cursors[cursorFiles[i].first] = cursors[i];
+    }
+
+    m_cursor = m_cursors[CURSOR_ARROW];
+
+    for (size_t i = 0; i < iconPaths.size(); ++i) {
+        if (!icons[i]) {
+            printf("Could not load %s\n", iconPaths[i].c_str());
+        }
     }
 
     return true;
 }
 
-bool CWindowManager::Draw(IFrameBuffer &fb, TRect &dirtyRect) {
-    auto dirty = DrawWindow(fb, m_desktop->GetRect(), *m_desktop.get(), false);
-    if (!dirty && !m_mouseDirty) {
-        return false;
+// Moves the pixels of the window dragged since the last frame instead of redrawing it.
+// The areas uncovered by the move are added to the damage of the desktop.
+void CWindowManager::MoveWindowPixels(CFrameBuffer &fb, CRegion &dirtyRegion) {
+    TRect oldRect, newRect;
+    if (!m_desktop->GetPendingMove(oldRect, newRect)) {
+        return;
     }
 
+    auto screen = m_desktop->GetRect();
+    auto dx = newRect.p0.x - oldRect.p0.x;
+    auto dy = newRect.p0.y - oldRect.p0.y;
+
+    // Only the part of the window that was on the screen can be moved
+    auto source = oldRect;
+    auto dest = TRect();
+    auto moved = screen.ClipRect(source);
+    if (moved) {
+        dest = source.Translated(dx, dy);
+        moved = screen.ClipRect(dest);
+    }
+
+    if (!moved) {
+        m_desktop->AddDamage(oldRect);
+        m_desktop->AddDamage(newRect);
+        return;
+    }
+
+    fb.MoveRect(dest.Translated(-dx, -dy), dest.p0);
+    dirtyRegion.Union(dest);
+    m_desktop->MoveDamage(oldRect, newRect);
+
+    // The uncovered desktop, and the parts of the window that were off screen
+    TRect exposed[4];
+    auto count = TRect::Subtract(oldRect, dest, exposed);
+    for (auto i = 0; i < count; ++i) {
+        m_desktop->AddDamage(exposed[i]);
+    }
+
+    count = TRect::Subtract(newRect, dest, exposed);
+    for (auto i = 0; i < count; ++i) {
+        m_desktop->AddDamage(exposed[i]);
+    }
+}
+
+// Large repaints are split into tiles that are drawn by several threads
+void CWindowManager::DrawDamage(CFrameBuffer &fb, const CRegion &damage) {
+    // Drawing does not modify the windows, so the tiles may share backing stores and display lists
+    PrepareDrawWindow(damage, *m_desktop.get());
+
+    // Framebuffers without pixels record the commands to draw them later
+    auto bounds = damage.GetBounds();
+    auto parallel = fb.Pixels() && m_scheduler->GetWorkerCount() >= 2;
+    if (!parallel || bounds.Width() * bounds.Height() < MinParallelArea) {
+        DrawWindow(fb, damage, *m_desktop.get(), true);
+        return;
+    }
+
+    std::vector<CRegion> tiles;
+    for (auto y = bounds.p0.y - bounds.p0.y % TileSize; y <= bounds.p1.y; y += TileSize) {
+        for (auto x = bounds.p0.x - bounds.p0.x % TileSize; x <= bounds.p1.x; x += TileSize) {
+            auto tile = damage;
+            tile.Intersect(TRect(x, y, x + TileSize - 1, y + TileSize - 1));
+            if (!tile.Empty()) {
+                tiles.push_back(tile);
+            }
+        }
+    }
+
+    m_scheduler->ParallelFor(0, tiles.size(), 1, [&](size_t begin, size_t end) {
+        // Each tile is drawn through its own framebuffer object, as drawing updates its state
+        CFrameBuffer tileFb(fb.Pixels(), fb.GetRect().Width(), fb.GetRect().Height(), fb.Pitch());
+        for (auto i = begin; i < end; ++i) {
+            DrawWindow(tileFb, tiles[i], *m_desktop.get(), true);
+        }
+    });
+
+    fb.Invalidate();
+}
+
+// Puts back the pixels that were under the pointer
+void CWindowManager::HideCursor(CFrameBuffer &fb) {
+    if (!m_cursorShown) {
+        return;
+    }
+
+    auto saved = TRect(0, 0, m_oldMouseRect.Width() - 1, m_oldMouseRect.Height() - 1);
+    fb.CopyPixels(*m_saveUnder.get(), saved, m_oldMouseRect.p0);
+    m_cursorShown = false;
+}
+
+// Saves the pixels under the pointer before drawing it
+void CWindowManager::ShowCursor(CFrameBuffer &fb) {
     // TODO: handle hotspot
     auto cursor = m_cursor->GetCursor();
-    if (cursor) {
-        // Clear the old pointer first
-        DrawWindow(fb, m_oldMouseRect, *m_desktop.get(), true);
+    if (!cursor) {
+        return;
+    }
+
+    // The pixels under the pointer cannot be read back from framebuffers that record commands
+    assert(fb.Pixels());
 
-        // Draw the new pointer
-        auto x = m_mousePosition.x - cursor->GetXHotspot();
-        auto y = m_mousePosition.y - cursor->GetYHotspot();
-        TRect rect(x, y, x + cursor->GetWidth(), y + cursor->GetHeight());
+    auto x = m_mousePosition.x - cursor->GetXHotspot();
+    auto y = m_mousePosition.y - cursor->GetYHotspot();
+    TRect rect(x, y, x + cursor->GetWidth(), y + cursor->GetHeight());
 
-        cursor->Draw(fb, x, y);
-        dirtyRect = TRect::Union(m_oldMouseRect, rect);
-        m_mouseDirty = false;
-        m_oldMouseRect = rect;
+    auto w = rect.Width();
+    auto h = rect.Height();
+    if (!m_saveUnder || m_saveUnder->GetRect().Width() != w || m_saveUnder->GetRect().Height() != h) {
+        m_saveUnder = CFrameBuffer::Create(nullptr, w, h, w * sizeof(uint32_t));
     }
 
-    if (dirty) {
-        dirtyRect = m_desktop->GetRect();
+    m_saveUnder->CopyPixels(fb, rect, TPoint(0, 0));
+    cursor->Draw(fb, x, y);
+    m_oldMouseRect = rect;
+    m_cursorShown = true;
+}
+
+bool CWindowManager::Draw(CFrameBuffer &fb, CRegion &dirtyRegion) {
+    dirtyRegion.Clear();
+    if (!m_mouseDirty && !m_desktop->HasPendingMove() && m_desktop->GetDamage().Empty()) {
+        return false;
     }
 
-    return true;
+    // The screen is updated without the pointer, which is drawn again on top at the end.
+    // It only needs to be presented when it moved, damaged areas are presented anyway.
+    if (m_mouseDirty && m_cursorShown) {
+        dirtyRegion.Union(m_oldMouseRect);
+    }
+    HideCursor(fb);
+
+    MoveWindowPixels(fb, dirtyRegion);
+
+    if (!m_desktop->GetDamage().Empty()) {
+        auto damage = m_desktop->GetDamage();
+        damage.Intersect(m_desktop->GetRect());
+        m_desktop->ClearDamage();
+
+        DrawDamage(fb, damage);
+
+        m_desktop->ClearDirty();
+        dirtyRegion.Union(damage);
+    }
+
+    if (m_cursorMode == CURSOR_MODE_FRAMEBUFFER) {
+        ShowCursor(fb);
+        if (m_mouseDirty) {
+            dirtyRegion.Union(m_oldMouseRect);
+        }
+    }
+    m_mouseDirty = false;
+
+    dirtyRegion.Intersect(m_desktop->GetRect());
+    return !dirtyRegion.Empty();
+}
+
+CFrameBufferPtr CWindowManager::GetCursorLayer(TPoint &position) {
+    auto cursor = m_cursor->GetCursor();
+    if (!cursor) {
+        return nullptr;
+    }
+
+    if (m_cursorLayerImage != cursor) {
+        auto w = cursor->GetWidth();
+        auto h = cursor->GetHeight();
+        m_cursorLayer = CFrameBuffer::Create(nullptr, w, h, w * sizeof(uint32_t));
+        m_cursorLayer->Fill(0);
+        cursor->Draw(*m_cursorLayer.get(), 0, 0);
+        m_cursorLayerImage = cursor;
+    }
+
+    position.x = m_mousePosition.x - cursor->GetXHotspot();
+    position.y = m_mousePosition.y - cursor->GetYHotspot();
+    return m_cursorLayer;
 }
 
 bool CWindowManager::SetCursor(ECursorType type) {
@@ -164,7 +334,10 @@ bool CWindowManager::SetCursor(ECursorType type) {
         return false;
     }
 
-    m_cursor = it->second;
+    if (m_cursor != it->second) {
+        m_cursor = it->second;
+        m_mouseDirty = true;
+    }
     return true;
 }
 
@@ -26,18 +26,29 @@
 
 #include "CPI.h"
 #include "Cursors.h"
+#include "Desktop.h"
+#include "Region.h"
+#include "TaskScheduler.h"
 #include "Window.h"
 
 namespace gui {
 
 class CCursor;
+class CImageData;
 class CWindowManager;
 using CWindowManagerPtr = std::shared_ptr<CWindowManager>;
 
+enum ECursorMode {
+    // The pointer is drawn in the framebuffer passed to Draw
+    CURSOR_MODE_FRAMEBUFFER,
+    // The pointer is left out of the framebuffer and composited by the caller, see GetCursorLayer
+    CURSOR_MODE_LAYER
+};
+
 class CWindowManager {
 private:
     CMouseRawEventsPtr m_mouseRawEvents;
-    CWindowPtr m_desktop;
+    CDesktopPtr m_desktop;
     CWindowPtr m_dragWnd;
     CWindowPtr m_prevWnd;
     TPoint m_dragOrigin;
@@ -45,18 +56,34 @@ private:
     bool m_mouseDirty;
     TPoint m_mousePosition;
     TRect m_oldMouseRect;
+
+    // Pixels under the pointer, saved before drawing it
+    CFrameBufferPtr m_saveUnder;
+    bool m_cursorShown;
+
+    ECursorMode m_cursorMode;
+    CFrameBufferPtr m_cursorLayer;
+    std::shared_ptr<CImageData> m_cursorLayerImage;
+
     std::string m_resourcePath;
 
     std::shared_ptr<font::CCPIFont> m_font;
 
+    // Shared by everything that runs in parallel
+    CTaskSchedulerPtr m_scheduler;
+
     std::unordered_map<ECursorType, std::shared_ptr<CCursor>> m_cursors;
     std::shared_ptr<CCursor> m_cursor;
 
-    CWindowManager(int width, int height, const std::string &resourcePath) {
+    CWindowManager(int width, int height, const std::string &resourcePath, unsigned workers) {
         m_mouseRawEvents = CMouseRawEvents::Create();
-        m_desktop = CWindow::Create(TRect(0, 0, width - 1, height - 1));
+        m_scheduler = CTaskScheduler::Create(workers);
+        m_desktop = CDesktop::Create(TRect(0, 0, width - 1, height - 1));
         m_dragWnd = nullptr;
         m_dragging = false;
+        m_mouseDirty = true;
+        m_cursorShown = false;
+        m_cursorMode = CURSOR_MODE_FRAMEBUFFER;
         m_resourcePath = resourcePath;
         m_mouseRawEvents->OnButtonUp.connect(sigc::mem_fun(*this, &CWindowManager::OnButtonUpHandler));
         m_mouseRawEvents->OnButtonDown.connect(sigc::mem_fun(*this, &CWindowManager::OnButtonDownHandler));
@@ -73,16 +100,25 @@ private:
         }
     }
 
-    bool LoadCursors();
     bool LoadResources();
 
+    // Repaints smaller than this are not worth spreading over several threads
+    static const int MinParallelArea = 256 * 256;
+    static const int TileSize = 128;
+
+    void MoveWindowPixels(CFrameBuffer &fb, CRegion &dirtyRegion);
+    void DrawDamage(CFrameBuffer &fb, const CRegion &damage);
+    void HideCursor(CFrameBuffer &fb);
+    void ShowCursor(CFrameBuffer &fb);
+
     void OnMoveHandler(const MouseState &state);
     void OnButtonDownHandler(const MouseState &state, MouseButton b);
     void OnButtonUpHandler(const MouseState &state, MouseButton b);
 
 public:
-    static CWindowManagerPtr Create(int width, int height, const std::string &resourcePath) {
-        auto ret = CWindowManagerPtr(new CWindowManager(width, height, resourcePath));
+    // workers is the number of threads of the task scheduler, 0 for one per core
+    static CWindowManagerPtr Create(int width, int height, const std::string &resourcePath, unsigned workers = 0) {
+        auto ret = CWindowManagerPtr(new CWindowManager(width, height, resourcePath, workers));
         if (!ret->LoadResources()) {
             return nullptr;
         }
@@ -103,15 +139,39 @@ public:
         r.p1.x = r.p0.x + width - 1;
         r.p1.y = r.p0.y + height - 1;
         m_desktop->SetRect(r);
+
+        // The output surface was recreated, even if its size did not change
+        m_desktop->SetDirty(true);
+        m_cursorShown = false;
     }
 
-    bool Draw(IFrameBuffer &fb, TRect &dirtyRect);
+    // Repaints the damaged parts of the screen. dirtyRegion receives
+    // the areas of fb that changed and must be presented.
+    bool Draw(CFrameBuffer &fb, CRegion &dirtyRegion);
 
     std::shared_ptr<font::CCPIFont> GetFont() {
         return m_font;
     }
 
+    CTaskSchedulerPtr GetScheduler() const {
+        return m_scheduler;
+    }
+
     bool SetCursor(ECursorType type);
+
+    void SetCursorMode(ECursorMode mode) {
+        m_cursorMode = mode;
+        m_mouseDirty = true;
+    }
+
+    ECursorMode GetCursorMode() const {
+        return m_cursorMode;
+    }
+
+    // Returns the image of the pointer with a transparent background,
+    // and where its top left corner must be drawn on the screen.
+    // The same framebuffer is returned until the pointer changes.
+    CFrameBufferPtr GetCursorLayer(TPoint &position);
 };
 } // namespace gui
 
@@ -25,14 +25,19 @@
 #include <memory>
 #include <sstream>
 
+#include "BackingStore.h"
 #include "Button.h"
 #include "CPI.h"
 #include "Cursor.h"
+#include "DisplayList.h"
 #include "Form.h"
 #include "Framebuffer.h"
 #include "GridLayout.h"
 #include "LabeledImage.h"
 #include "Mouse.h"
+#include "PixelFormat.h"
+#include "Region.h"
+#include "RenderThread.h"
 #include "Window.h"
 #include "WindowManager.h"
 
@@ -66,7 +71,18 @@ static MouseState GetMouseState() {
     return ret;
 }
 
-bool PollEvents(SDL_Event *Event, CMouseRawEvents &events, bool &needResizing) {
+static void FlushMotion(CMouseRawEvents &events, bool &needMoving) {
+    events.OnMove.emit(GetMouseState());
+    needMoving = false;
+}
+
+// Motion events only set needMoving, consecutive ones are handled at once
+// by FlushMotion with the latest position.
+bool PollEvents(SDL_Event *Event, CMouseRawEvents &events, bool &needResizing, bool &needMoving) {
+    if (Event->type != SDL_MOUSEMOTION && needMoving) {
+        FlushMotion(events, needMoving);
+    }
+
     auto mouseState = GetMouseState();
 
     switch (Event->type) {
@@ -83,7 +99,11 @@ bool PollEvents(SDL_Event *Event, CMouseRawEvents &events, bool &needResizing) {
             break;
 
         case SDL_MOUSEMOTION:
-            events.OnMove.emit(mouseState);
+            needMoving = true;
+            break;
+
+        case SDL_USEREVENT:
+            // The render thread is done with a frame
             break;
 
         case SDL_WINDOWEVENT: {
@@ -99,6 +119,90 @@ bool PollEvents(SDL_Event *Event, CMouseRawEvents &events, bool &needResizing) {
     return false;
 }
 
+static EPixelFormat GetPixelFormat(Uint32 format) {
+    switch (format) {
+        case SDL_PIXELFORMAT_XRGB8888:
+            return PIXEL_FORMAT_XRGB8888;
+        case SDL_PIXELFORMAT_ARGB8888:
+            return PIXEL_FORMAT_ARGB8888;
+        case SDL_PIXELFORMAT_BGRA8888:
+            return PIXEL_FORMAT_BGRA8888;
+        case SDL_PIXELFORMAT_RGB565:
+            return PIXEL_FORMAT_RGB565;
+        default:
+            return PIXEL_FORMAT_UNKNOWN;
+    }
+}
+
+// Picks a texture format that the renderer supports without converting it.
+// XRGB8888 comes first, as the alpha of the framebuffer is not meant to be shown,
+// then the other formats the framebuffer renders to natively, then the ones
+// we can convert to ourselves.
+static Uint32 GetTextureFormat(SDL_Renderer *renderer) {
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) < 0) {
+        return SDL_PIXELFORMAT_XRGB8888;
+    }
+
+    for (auto i = 0u; i < info.num_texture_formats; ++i) {
+        if (info.texture_formats[i] == SDL_PIXELFORMAT_XRGB8888) {
+            return info.texture_formats[i];
+        }
+    }
+
+    for (auto i = 0u; i < info.num_texture_formats; ++i) {
+        if (IsNativePixelFormat(GetPixelFormat(info.texture_formats[i]))) {
+            return info.texture_formats[i];
+        }
+    }
+
+    for (auto i = 0u; i < info.num_texture_formats; ++i) {
+        if (GetPixelFormat(info.texture_formats[i]) != PIXEL_FORMAT_UNKNOWN) {
+            return info.texture_formats[i];
+        }
+    }
+
+    return SDL_PIXELFORMAT_XRGB8888;
+}
+
+// Frames are not drawn more often than the display refreshes
+static steady_clock::duration GetFrameInterval(SDL_Window *window) {
+    SDL_DisplayMode mode;
+    auto index = SDL_GetWindowDisplayIndex(window);
+    if (index < 0 || SDL_GetCurrentDisplayMode(index, &mode) < 0 || mode.refresh_rate <= 0) {
+        mode.refresh_rate = 60;
+    }
+    return duration_cast<steady_clock::duration>(seconds(1)) / mode.refresh_rate;
+}
+
+// Copies the rectangles of region from the framebuffer to the texture
+static void UploadRegion(SDL_Texture *texture, EPixelFormat format, CFrameBuffer &fb, const CRegion &region) {
+    auto pixelsPitch = fb.Pitch() / sizeof(uint32_t);
+    for (const auto &r : region.GetRects()) {
+        SDL_Rect rect;
+        rect.x = r.p0.x;
+        rect.y = r.p0.y;
+        rect.h = r.Height();
+        rect.w = r.Width();
+
+        auto source = fb.Pixels() + r.p0.y * pixelsPitch + r.p0.x;
+        if (IsNativePixelFormat(format)) {
+            SDL_UpdateTexture(texture, &rect, source, fb.Pitch());
+            continue;
+        }
+
+        void *pixels;
+        int pitch;
+        if (SDL_LockTexture(texture, &rect, &pixels, &pitch) < 0) {
+            abort();
+        }
+
+        ConvertPixels(format, pixels, pitch, source, pixelsPitch, rect.w, rect.h);
+
+        SDL_UnlockTexture(texture);
+    }
+}
+
 void UpdateFPS(SDL_Window *window, steady_clock::time_point &start, uint32_t &frameCount) {
     auto t2 = steady_clock::now();
     auto diff = t2 - start;
@@ -107,7 +211,8 @@ void UpdateFPS(SDL_Window *window, steady_clock::time_point &start, uint32_t &fr
         start = t2;
 
         std::stringstream ss;
-        ss << frameCount / (ms / 1000.0) << " FPS";
+        ss << frameCount / (ms / 1000.0) << " FPS, ";
+        ss << CBackingStore::GetUsedBytes() / 1024 << " KB in backing stores";
         auto str = ss.str();
         SDL_SetWindowTitle(window, str.c_str());
         start = t2;
@@ -132,11 +237,43 @@ int main(int argc, char *argv[]) {
     int width = 1280;
     int height = 1024;
 
-    if (argc != 2) {
-        printf("Usage: %s /path/to/resources\n", argv[0]);
+    // The pointer is drawn in the framebuffer unless it is asked to be a separate texture
+    auto cursorMode = CURSOR_MODE_FRAMEBUFFER;
+    auto useRenderThread = false;
+    auto usage = argc < 2;
+    for (auto i = 2; i < argc; ++i) {
+        auto option = std::string(argv[i]);
+        if (option == "--cursor-layer") {
+            cursorMode = CURSOR_MODE_LAYER;
+        } else if (option == "--render-thread") {
+            useRenderThread = true;
+        } else if (option == "--immediate") {
+            // Windows are painted by calling Draw every time
+            CWindow::SetRetainedMode(false);
+        } else {
+            usage = true;
+        }
+    }
+
+    if (usage) {
+        printf("Usage: %s /path/to/resources [--cursor-layer] [--render-thread] [--immediate]\n", argv[0]);
         return -1;
     }
 
+    // Frames are recorded on this thread and drawn on the render thread.
+    // The pixels under the pointer cannot be read back while recording, and
+    // windows are not drawn into backing stores, as that would happen here.
+    CRenderThreadPtr renderThread;
+    if (useRenderThread) {
+        cursorMode = CURSOR_MODE_LAYER;
+        CBackingStore::SetLimitBytes(0);
+        renderThread = CRenderThread::Create([]() {
+            SDL_Event event = {};
+            event.type = SDL_USEREVENT;
+            SDL_PushEvent(&event);
+        });
+    }
+
     auto resourcePath = std::string(argv[1]);
 
     SDL_Init(SDL_INIT_VIDEO);
@@ -144,9 +281,21 @@ int main(int argc, char *argv[]) {
     SDL_Window *window =
         SDL_CreateWindow("GUI", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, height, SDL_WINDOW_RESIZABLE);
     SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-    SDL_Surface *surface = nullptr;
     SDL_Texture *texture = nullptr;
 
+    auto textureFormat = GetTextureFormat(renderer);
+    auto pixelFormat = GetPixelFormat(textureFormat);
+    printf("Texture format %s\n", SDL_GetPixelFormatName(textureFormat));
+
+    // Everything is drawn off screen, as the contents of a locked texture are
+    // not kept between frames. Formats the framebuffer cannot render to are
+    // converted on upload.
+    CFrameBufferPtr shadow;
+    std::shared_ptr<CRecordingFrameBuffer> recording;
+
+    // Damage drawn by the render thread, to present once it is done
+    CRegion renderedRegion;
+
     auto frameCount = 0u;
     auto lastPrinted = steady_clock::now();
 
@@ -157,6 +306,11 @@ int main(int argc, char *argv[]) {
     }
 
     g_wndMgr = wndMgr;
+    wndMgr->SetCursorMode(cursorMode);
+
+    SDL_Texture *cursorTexture = nullptr;
+    CFrameBufferPtr cursorImage;
+    SDL_Rect cursorRect = {0, 0, 0, 0};
 
     // MyApp::Create(wndMgr->GetDesktop());
     auto desktop = wndMgr->GetDesktop();
@@ -175,58 +329,133 @@ int main(int argc, char *argv[]) {
     SDL_ShowCursor(0);
 
     bool needResizing = true;
+    bool needMoving = false;
+    bool quit = false;
+    auto frameInterval = GetFrameInterval(window);
+    auto lastFrame = steady_clock::now() - frameInterval;
+    auto &mouseEvents = *wndMgr->GetRawMouseEvents().get();
 
     do {
         SDL_Event Event;
 
-        if (SDL_WaitEvent(&Event)) {
-            if (PollEvents(&Event, *wndMgr->GetRawMouseEvents().get(), needResizing)) {
+        // Nothing is drawn until something happens
+        if (!SDL_WaitEvent(&Event)) {
+            continue;
+        }
+
+        quit = PollEvents(&Event, mouseEvents, needResizing, needMoving);
+
+        // Everything that arrives until the next refresh goes in the same frame
+        while (!quit) {
+            auto remaining = duration_cast<milliseconds>(lastFrame + frameInterval - steady_clock::now()).count();
+            auto received = remaining > 0 ? SDL_WaitEventTimeout(&Event, remaining) : SDL_PollEvent(&Event);
+            if (!received) {
                 break;
             }
+            quit = PollEvents(&Event, mouseEvents, needResizing, needMoving);
+        }
+
+        if (quit) {
+            break;
+        }
+
+        if (needMoving) {
+            FlushMotion(mouseEvents, needMoving);
         }
 
         if (needResizing) {
+            frameInterval = GetFrameInterval(window);
             if (texture) {
                 SDL_DestroyTexture(texture);
             }
 
-            surface = SDL_GetWindowSurface(window);
-
             SDL_GetWindowSize(window, &width, &height);
-            texture = SDL_CreateTexture(renderer, surface->format->format, SDL_TEXTUREACCESS_STREAMING, width, height);
+            texture = SDL_CreateTexture(renderer, textureFormat, SDL_TEXTUREACCESS_STREAMING, width, height);
+
+            // Pixels that are not opaque, such as those of windows without a color,
+            // replace what is on screen instead of being blended with it
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+            if (renderThread) {
+                renderThread->Wait();
+                renderedRegion.Clear();
+                recording = std::make_shared<CRecordingFrameBuffer>(width, height);
+            }
+
+            shadow = CFrameBuffer::Create(nullptr, width, height, width * sizeof(uint32_t));
+            if (renderThread) {
+                renderThread->SetTarget(shadow);
+            }
 
-            wndMgr->Resize(surface->w, surface->h);
+            wndMgr->Resize(width, height);
             needResizing = false;
         }
 
-        TRect dirtyRect;
-
-        void *pixels;
-        int pitch;
-        if (SDL_LockTexture(texture, nullptr, &pixels, &pitch) < 0) {
-            abort();
+        CRegion dirtyRegion;
+        auto dirty = false;
+        if (!renderThread) {
+            dirty = wndMgr->Draw(*shadow.get(), dirtyRegion);
+            UploadRegion(texture, pixelFormat, *shadow.get(), dirtyRegion);
+        } else if (renderThread->IsIdle()) {
+            // The last frame was drawn, it is uploaded before the next one is submitted
+            dirtyRegion = renderedRegion;
+            dirty = !dirtyRegion.Empty();
+            UploadRegion(texture, pixelFormat, *shadow.get(), dirtyRegion);
+
+            if (wndMgr->Draw(*recording.get(), renderedRegion)) {
+                renderThread->Submit(recording->TakeDisplayList());
+            }
         }
 
-        CFrameBuffer framebuffer((uint32_t *) pixels, width, height, pitch);
-
-        auto dirty = wndMgr->Draw(framebuffer, dirtyRect);
+        auto cursorMoved = false;
+        if (cursorMode == CURSOR_MODE_LAYER) {
+            TPoint position;
+            auto image = wndMgr->GetCursorLayer(position);
+            if (image != cursorImage) {
+                if (cursorTexture) {
+                    SDL_DestroyTexture(cursorTexture);
+                    cursorTexture = nullptr;
+                }
+
+                cursorImage = image;
+                if (image) {
+                    auto &r = image->GetRect();
+                    cursorTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                                                      r.Width(), r.Height());
+                    SDL_UpdateTexture(cursorTexture, nullptr, image->Pixels(), r.Width() * sizeof(uint32_t));
+                    SDL_SetTextureBlendMode(cursorTexture, SDL_BLENDMODE_BLEND);
+                }
+                cursorMoved = true;
+            }
 
-        SDL_UnlockTexture(texture);
+            // What was under the pointer is uncovered by presenting the whole texture again
+            if (cursorRect.x != position.x || cursorRect.y != position.y) {
+                cursorMoved = true;
+            }
 
-        if (dirty) {
-            SDL_Rect srect;
-            srect.x = dirtyRect.p0.x;
-            srect.y = dirtyRect.p0.y;
-            srect.h = dirtyRect.Height();
-            srect.w = dirtyRect.Width();
+            cursorRect.x = position.x;
+            cursorRect.y = position.y;
+            cursorRect.w = image ? image->GetRect().Width() : 0;
+            cursorRect.h = image ? image->GetRect().Height() : 0;
+        }
 
-            SDL_RenderCopy(renderer, texture, &srect, &srect);
+        if (dirty || cursorMoved) {
+            // Only the damage was uploaded, but the whole texture is copied, as
+            // the contents of the backbuffer are undefined after a present
+            SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+            if (cursorTexture) {
+                SDL_RenderCopy(renderer, cursorTexture, nullptr, &cursorRect);
+            }
             SDL_RenderPresent(renderer);
         }
 
+        lastFrame = steady_clock::now();
         UpdateFPS(window, lastPrinted, frameCount);
     } while (true);
 
+    renderThread = nullptr;
+    if (cursorTexture) {
+        SDL_DestroyTexture(cursorTexture);
+    }
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
@@ -0,0 +1,120 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+// Checks that repainting the damage of one window leaves the windows
+// outside of it alone.
+
+#include <stdio.h>
+#include <vector>
+
+#include "Desktop.h"
+#include "Framebuffer.h"
+
+using namespace gui;
+
+class CCountingWindow;
+using CCountingWindowPtr = std::shared_ptr<CCountingWindow>;
+
+// Counts the calls to Draw
+class CCountingWindow : public CWindow {
+public:
+    mutable int m_draws;
+
+    CCountingWindow(const this_is_private &p, TRect rect) : CWindow(p, rect), m_draws(0) {
+    }
+
+    static CCountingWindowPtr Create(TRect rect) {
+        return std::make_shared<CCountingWindow>(this_is_private{0}, rect);
+    }
+
+    virtual void Draw(IFrameBuffer &fb) const {
+        ++m_draws;
+        CWindow::Draw(fb);
+    }
+};
+
+static int s_failures = 0;
+
+static void Check(bool b, const char *what) {
+    if (!b) {
+        printf("FAIL: %s\n", what);
+        ++s_failures;
+    }
+}
+
+static void Repaint(CFrameBuffer &fb, CDesktop &desktop) {
+    PrepareDrawWindow(desktop.GetDamage(), desktop);
+    DrawWindow(fb, desktop.GetDamage(), desktop, true);
+    desktop.ClearDamage();
+    desktop.ClearDirty();
+}
+
+static void ResetCounts(const std::vector<CCountingWindowPtr> &windows) {
+    for (auto &w : windows) {
+        w->m_draws = 0;
+    }
+}
+
+int main() {
+    const int width = 200, height = 100;
+    std::vector<uint32_t> pixels(width * height);
+    CFrameBuffer fb(pixels.data(), width, height, width * sizeof(uint32_t));
+
+    // Draw is called every time a window is painted in immediate mode
+    CWindow::SetRetainedMode(false);
+
+    auto desktop = CDesktop::Create(TRect(0, 0, width - 1, height - 1));
+    auto left = CCountingWindow::Create(TRect(0, 0, 99, 99));
+    auto leftChild = CCountingWindow::Create(TRect(10, 10, 49, 49));
+    auto right = CCountingWindow::Create(TRect(100, 0, 199, 99));
+    auto rightChild = CCountingWindow::Create(TRect(10, 10, 49, 49));
+    desktop->AddChild(left);
+    desktop->AddChild(right);
+    left->AddChild(leftChild);
+    right->AddChild(rightChild);
+    std::vector<CCountingWindowPtr> windows = {left, leftChild, right, rightChild};
+
+    Repaint(fb, *desktop.get());
+    Check(left->m_draws && leftChild->m_draws, "left subtree drawn initially");
+    Check(right->m_draws && rightChild->m_draws, "right subtree drawn initially");
+
+    ResetCounts(windows);
+    leftChild->SetColor(RGB(255, 0, 0));
+    Repaint(fb, *desktop.get());
+    Check(leftChild->m_draws, "dirty window redrawn");
+    Check(!left->m_draws, "covered parent not redrawn");
+    Check(!right->m_draws && !rightChild->m_draws, "clean sibling subtree not visited");
+    Check(!leftChild->IsDirty() && !desktop->HasDirtyChildren(), "dirty flags cleared");
+    Check(pixels[20 * width + 20] == RGB(255, 0, 0), "dirty window painted");
+
+    // Moving a window damages clean windows, which must be painted again
+    ResetCounts(windows);
+    rightChild->SetRect(TRect(20, 10, 59, 49));
+    Repaint(fb, *desktop.get());
+    Check(right->m_draws && rightChild->m_draws, "windows under moved window redrawn");
+    Check(!left->m_draws && !leftChild->m_draws, "clean sibling subtree not visited after move");
+
+    if (s_failures) {
+        return 1;
+    }
+
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,82 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+// Checks the cache of scaled copies of a framebuffer
+
+#include <stdio.h>
+
+#include "Framebuffer.h"
+
+using namespace gui;
+
+static int s_failures = 0;
+
+static void Check(bool b, const char *what) {
+    if (!b) {
+        printf("FAIL: %s\n", what);
+        ++s_failures;
+    }
+}
+
+int main() {
+    const int width = 16, height = 16;
+    auto image = CFrameBuffer::Create(nullptr, width, height, width * sizeof(uint32_t));
+    image->Fill(RGB(10, 20, 30));
+    auto source = image->GetRect();
+
+    // A repeated request returns the same copy
+    auto a = image->GetScaled(source, 8, 8);
+    Check(a != nullptr, "scaled copy created");
+    Check(image->GetScaled(source, 8, 8) == a, "same size reuses the copy");
+    Check(image->GetScaled(TRect(0, 0, 7, 7), 8, 8) != a, "other source rectangle gets its own copy");
+
+    // Four copies fit, using a again makes b the oldest one
+    image = CFrameBuffer::Create(nullptr, width, height, width * sizeof(uint32_t));
+    a = image->GetScaled(source, 8, 8);
+    auto b = image->GetScaled(source, 9, 9);
+    auto c = image->GetScaled(source, 10, 10);
+    auto d = image->GetScaled(source, 11, 11);
+    Check(image->GetScaled(source, 8, 8) == a, "copy kept while the cache is not full");
+    auto e = image->GetScaled(source, 12, 12);
+
+    Check(image->GetScaled(source, 10, 10) == c, "recent copy kept after eviction");
+    Check(image->GetScaled(source, 11, 11) == d, "recent copy kept after eviction");
+    Check(image->GetScaled(source, 8, 8) == a, "recently used copy kept after eviction");
+    Check(image->GetScaled(source, 12, 12) == e, "new copy kept");
+    Check(image->GetScaled(source, 9, 9) != b, "fifth size evicts the least recently used copy");
+
+    // Changing the pixels drops the copies, which are made again from the new pixels
+    a = image->GetScaled(source, 8, 8);
+    image->Invalidate();
+    auto a2 = image->GetScaled(source, 8, 8);
+    Check(a2 != a, "Invalidate clears the cache");
+
+    image->Fill(RGB(40, 50, 60));
+    auto a3 = image->GetScaled(source, 8, 8);
+    Check(a3 != a2, "drawing clears the cache");
+    Check(a3->GetPixel(4, 4) == RGB(40, 50, 60), "new copy has the new pixels");
+
+    if (s_failures) {
+        return 1;
+    }
+
+    printf("OK\n");
+    return 0;
+}
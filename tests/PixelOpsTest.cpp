@@ -0,0 +1,238 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+// Compares the pixel kernels selected for this CPU with plain scalar code
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "Framebuffer.h"
+#include "PixelOps.h"
+
+using namespace gui;
+
+static uint32_t LerpPixel(uint32_t a, uint32_t b, uint32_t weight) {
+    uint32_t ret = 0;
+    for (auto shift = 0; shift < 32; shift += 8) {
+        auto ca = (a >> shift) & 0xff;
+        auto cb = (b >> shift) & 0xff;
+        ret |= ((ca * (256 - weight) + cb * weight) >> 8) << shift;
+    }
+    return ret;
+}
+
+// Position in 16.16 fixed point of the center of destination pixel i, and the
+// source pixel to its left or above with the weight of the next one
+static void SourcePosition(int i, int sourceSize, int destSize, int &index, uint32_t &weight) {
+    auto step = (int32_t) (((int64_t) sourceSize << 16) / destSize);
+    auto pos = i * step + step / 2 - 0x8000;
+    if (pos < 0) {
+        pos = 0;
+    }
+
+    index = pos >> 16;
+    weight = (pos >> 8) & 0xff;
+    if (index >= sourceSize - 1) {
+        index = sourceSize - 1;
+        weight = 0;
+    }
+}
+
+// Vertical interpolation first, then horizontal, as ScaleBilinear does
+static void ScaleBilinearReference(std::vector<uint32_t> &dest, int destWidth, int destHeight,
+                                   const std::vector<uint32_t> &source, int sourceWidth, int sourceHeight) {
+    std::vector<uint32_t> row(sourceWidth + 1);
+    for (auto y = 0; y < destHeight; ++y) {
+        int sy;
+        uint32_t wy;
+        SourcePosition(y, sourceHeight, destHeight, sy, wy);
+        auto top = &source[sy * sourceWidth];
+        auto bottom = sy + 1 < sourceHeight ? top + sourceWidth : top;
+        for (auto x = 0; x < sourceWidth; ++x) {
+            row[x] = LerpPixel(top[x], bottom[x], wy);
+        }
+        row[sourceWidth] = row[sourceWidth - 1];
+
+        for (auto x = 0; x < destWidth; ++x) {
+            int sx;
+            uint32_t wx;
+            SourcePosition(x, sourceWidth, destWidth, sx, wx);
+            dest[y * destWidth + x] = LerpPixel(row[sx], row[sx + 1], wx);
+        }
+    }
+}
+
+// Straight alpha blend of one pixel, rounded to the nearest integer over opaque destinations
+static uint32_t BlendReference(uint32_t source, uint32_t dest) {
+    auto a = source >> 24;
+    if (a == 0xff) {
+        return source;
+    } else if (a == 0) {
+        return dest;
+    } else if ((dest >> 24) != 0xff) {
+        return ApplyAlphaBlend(source, dest);
+    }
+
+    uint32_t ret = 0xff000000;
+    for (auto shift = 0; shift < 24; shift += 8) {
+        auto cs = (source >> shift) & 0xff;
+        auto cd = (dest >> shift) & 0xff;
+        ret |= ((cs * a + cd * (255 - a) + 127) / 255) << shift;
+    }
+    return ret;
+}
+
+// Rows of every length up to a few vectors, so that both the vector loops and
+// their scalar tails run. Some alphas are 0 or 255 and some destinations translucent.
+static int CheckBlend() {
+    auto failures = 0;
+
+    // The first four pixels go through the vector loop, the last one through the scalar tail
+    std::vector<uint32_t> row(5, 0xfff9785b);
+    pixels::BlendRow(row.data(), std::vector<uint32_t>(5, 0xa9af2bcf).data(), 5);
+    for (auto i = 0; i < 5; ++i) {
+        if (row[i] != 0xffc845a8) {
+            printf("FAIL: blend of a9af2bcf over fff9785b at %d: %08x\n", i, row[i]);
+            ++failures;
+        }
+    }
+
+    static const uint32_t alphas[] = {0, 0xff, 0x01, 0x80, 0xfe};
+    for (auto count = 1; count <= 37; ++count) {
+        for (auto translucent = 0; translucent < 2; ++translucent) {
+            std::vector<uint32_t> source(count), dest(count), expected(count);
+            for (auto i = 0; i < count; ++i) {
+                auto r = rand() % 8;
+                auto a = r < 5 ? alphas[r] : (uint32_t) rand() & 0xff;
+                source[i] = (a << 24) | (((uint32_t) rand() ^ ((uint32_t) rand() << 12)) & 0xffffff);
+                dest[i] = 0xff000000 | (((uint32_t) rand() ^ ((uint32_t) rand() << 12)) & 0xffffff);
+                if (translucent && rand() % 4 == 0) {
+                    dest[i] &= 0x7fffffff;
+                }
+                expected[i] = BlendReference(source[i], dest[i]);
+            }
+
+            pixels::BlendRow(dest.data(), source.data(), count);
+            for (auto i = 0; i < count; ++i) {
+                if (dest[i] != expected[i]) {
+                    printf("FAIL: blend of %08x, row of %d at %d: %08x instead of %08x\n", source[i], count, i,
+                           dest[i], expected[i]);
+                    ++failures;
+                }
+            }
+        }
+    }
+
+    return failures;
+}
+
+// Source pixel under the center of each destination pixel. Widths around the
+// vector sizes exercise the gather loop and its tail, heights larger than the
+// source the copy of repeated rows.
+static int CheckNearest() {
+    auto failures = 0;
+    const int widths[] = {1, 2, 3, 7, 8, 9, 15, 16, 17, 31, 33, 65};
+    const int heights[] = {1, 3, 8};
+    for (auto sw : widths) {
+        for (auto dw : widths) {
+            for (auto sh : heights) {
+                for (auto dh : heights) {
+                    // Both images are wider than their rows to catch reads and writes past the end
+                    const auto sourcePitch = sw + 2, pitch = dw + 3;
+                    const uint32_t guard = 0xdeadbeef;
+                    std::vector<uint32_t> source(sourcePitch * sh, guard);
+                    for (auto y = 0; y < sh; ++y) {
+                        for (auto x = 0; x < sw; ++x) {
+                            source[y * sourcePitch + x] = (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+                        }
+                    }
+
+                    std::vector<uint32_t> dest(pitch * dh, guard);
+                    pixels::ScaleNearest(dest.data(), pitch, dw, dh, source.data(), sourcePitch, sw, sh);
+
+                    for (auto y = 0; y < dh; ++y) {
+                        auto sy = (2 * y + 1) * sh / (2 * dh);
+                        for (auto x = 0; x < pitch; ++x) {
+                            auto sx = (2 * x + 1) * sw / (2 * dw);
+                            auto want = x < dw ? source[sy * sourcePitch + sx] : guard;
+                            if (dest[y * pitch + x] != want) {
+                                printf("FAIL: nearest %dx%d -> %dx%d at %d,%d: %08x instead of %08x\n", sw, sh, dw,
+                                       dh, x, y, dest[y * pitch + x], want);
+                                ++failures;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return failures;
+}
+
+static int CheckBilinear() {
+    auto failures = 0;
+    const int sizes[] = {1, 2, 3, 4, 5, 7, 8, 9, 13, 16, 31, 33, 64, 65};
+    for (auto sw : sizes) {
+        for (auto dw : sizes) {
+            const int sh = 5, dh = 7;
+            std::vector<uint32_t> source(sw * sh);
+            for (auto &p : source) {
+                p = (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+            }
+
+            // The destination is wider than the image to catch writes past the end of rows
+            const auto pitch = dw + 3;
+            const uint32_t guard = 0xdeadbeef;
+            std::vector<uint32_t> dest(pitch * dh, guard), expected(dw * dh);
+            pixels::ScaleBilinear(dest.data(), pitch, dw, dh, source.data(), sw, sw, sh);
+            ScaleBilinearReference(expected, dw, dh, source, sw, sh);
+
+            for (auto y = 0; y < dh; ++y) {
+                for (auto x = 0; x < pitch; ++x) {
+                    auto want = x < dw ? expected[y * dw + x] : guard;
+                    if (dest[y * pitch + x] != want) {
+                        printf("FAIL: bilinear %dx%d -> %dx%d at %d,%d: %08x instead of %08x\n", sw, sh, dw, dh, x,
+                               y, dest[y * pitch + x], want);
+                        ++failures;
+                    }
+                }
+            }
+        }
+    }
+
+    return failures;
+}
+
+int main() {
+    printf("Kernels: %s\n", pixels::GetKernelName());
+    srand(1);
+
+    auto failures = CheckBlend();
+    failures += CheckNearest();
+    failures += CheckBilinear();
+    if (failures) {
+        return 1;
+    }
+
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,142 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+// Checks that the task scheduler runs every task once and that waiting for a
+// group returns, whether its tasks are queued, nested or running elsewhere.
+// A missed wake up hangs the test until ctest times it out.
+
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "TaskScheduler.h"
+
+using namespace gui;
+
+static const unsigned Workers = 4;
+
+static int s_failures = 0;
+
+static void Check(bool b, const char *what) {
+    if (!b) {
+        printf("FAIL: %s\n", what);
+        ++s_failures;
+    }
+}
+
+// Every index is passed once, in ranges of at most grain items
+static void CheckParallelFor(CTaskScheduler &scheduler, size_t begin, size_t end, size_t grain) {
+    std::vector<std::atomic<int>> counts(end + 1);
+    for (auto &c : counts) {
+        c = 0;
+    }
+
+    std::atomic<bool> badRange(false);
+    scheduler.ParallelFor(begin, end, grain, [&](size_t b, size_t e) {
+        if (b < begin || e > end || b >= e || e - b > (grain ? grain : 1)) {
+            badRange = true;
+            return;
+        }
+        for (auto i = b; i < e; ++i) {
+            ++counts[i];
+        }
+    });
+
+    Check(!badRange, "ParallelFor ranges within bounds and grain");
+    for (auto i = 0u; i <= end; ++i) {
+        if (counts[i] != (i >= begin && i < end ? 1 : 0)) {
+            printf("FAIL: ParallelFor(%zu, %zu, %zu) ran index %u %d times\n", begin, end, grain, i, counts[i].load());
+            ++s_failures;
+            return;
+        }
+    }
+}
+
+// Each task of the outer group waits for its own group from a worker
+static void CheckNested(CTaskScheduler &scheduler) {
+    const int outer = 16, inner = 16;
+    std::atomic<int> count(0);
+    {
+        CTaskGroup group(scheduler);
+        for (auto i = 0; i < outer; ++i) {
+            group.Run([&]() {
+                CTaskGroup nested(scheduler);
+                for (auto j = 0; j < inner; ++j) {
+                    nested.Run([&]() { ++count; });
+                }
+                nested.Wait();
+            });
+        }
+        group.Wait();
+    }
+
+    Check(count == outer * inner, "nested groups run all their tasks");
+}
+
+// The tasks hold their workers until all of them have started, so that the
+// queues are empty and the waiter has nothing to help with when they finish
+static void CheckWaitForRunning(CTaskScheduler &scheduler) {
+    const int tasks = Workers - 1;
+    for (auto round = 0; round < 50; ++round) {
+        std::atomic<int> started(0), done(0);
+        CTaskGroup group(scheduler);
+        for (auto i = 0; i < tasks; ++i) {
+            group.Run([&]() {
+                ++started;
+                while (started < tasks) {
+                    std::this_thread::yield();
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(round % 3));
+                ++done;
+            });
+        }
+        group.Wait();
+
+        if (done != tasks) {
+            Check(false, "Wait returns after the tasks running on other workers");
+            return;
+        }
+    }
+}
+
+int main() {
+    auto scheduler = CTaskScheduler::Create(Workers);
+    Check(scheduler->GetWorkerCount() == Workers, "worker count");
+
+    CheckParallelFor(*scheduler.get(), 0, 0, 4);
+    CheckParallelFor(*scheduler.get(), 0, 1, 4);
+    CheckParallelFor(*scheduler.get(), 0, 100, 1);
+    CheckParallelFor(*scheduler.get(), 0, 100, 7);
+    CheckParallelFor(*scheduler.get(), 3, 100, 10);
+    CheckParallelFor(*scheduler.get(), 5, 1000, 0);
+    CheckParallelFor(*scheduler.get(), 0, 1000, 999);
+    CheckParallelFor(*scheduler.get(), 0, 1000, 5000);
+
+    CheckNested(*scheduler.get());
+    CheckWaitForRunning(*scheduler.get());
+
+    if (s_failures) {
+        return 1;
+    }
+
+    printf("OK\n");
+    return 0;
+}
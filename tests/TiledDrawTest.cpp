@@ -0,0 +1,141 @@
+/// Copyright (c) 2020 Vitaly Chipounov
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in all
+/// copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+/// SOFTWARE.
+
+// Checks that a repaint split into tiles drawn by several threads paints the
+// same pixels as a serial one, with and without room for backing stores.
+// Run it under ThreadSanitizer to check that drawing does not modify the windows.
+
+#include <stdio.h>
+#include <vector>
+
+#include "BackingStore.h"
+#include "Desktop.h"
+#include "Framebuffer.h"
+#include "TaskScheduler.h"
+
+using namespace gui;
+
+static const int TileSize = 64;
+
+static int s_failures = 0;
+
+static void Check(bool b, const char *what) {
+    if (!b) {
+        printf("FAIL: %s\n", what);
+        ++s_failures;
+    }
+}
+
+// Same split as CWindowManager::DrawDamage
+static void DrawTiled(CTaskScheduler &scheduler, CFrameBuffer &fb, const CRegion &damage, CWindow &root) {
+    PrepareDrawWindow(damage, root);
+
+    auto bounds = damage.GetBounds();
+    std::vector<CRegion> tiles;
+    for (auto y = bounds.p0.y - bounds.p0.y % TileSize; y <= bounds.p1.y; y += TileSize) {
+        for (auto x = bounds.p0.x - bounds.p0.x % TileSize; x <= bounds.p1.x; x += TileSize) {
+            auto tile = damage;
+            tile.Intersect(TRect(x, y, x + TileSize - 1, y + TileSize - 1));
+            if (!tile.Empty()) {
+                tiles.push_back(tile);
+            }
+        }
+    }
+
+    scheduler.ParallelFor(0, tiles.size(), 1, [&](size_t begin, size_t end) {
+        CFrameBuffer tileFb(fb.Pixels(), fb.GetRect().Width(), fb.GetRect().Height(), fb.Pitch());
+        for (auto i = begin; i < end; ++i) {
+            DrawWindow(tileFb, tiles[i], root, true);
+        }
+    });
+}
+
+// Repaints the whole desktop serially into expected and tiled into actual
+static bool RepaintMatches(CTaskScheduler &scheduler, CDesktop &desktop, CFrameBuffer &expected,
+                           CFrameBuffer &actual) {
+    auto damage = CRegion(desktop.GetRect());
+    DrawTiled(scheduler, actual, damage, desktop);
+
+    PrepareDrawWindow(damage, desktop);
+    DrawWindow(expected, damage, desktop, true);
+    desktop.ClearDirty();
+
+    auto rect = desktop.GetRect();
+    for (auto y = 0; y < rect.Height(); ++y) {
+        for (auto x = 0; x < rect.Width(); ++x) {
+            if (expected.GetPixel(x, y) != actual.GetPixel(x, y)) {
+                printf("pixel %d,%d: %08x instead of %08x\n", x, y, actual.GetPixel(x, y), expected.GetPixel(x, y));
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main() {
+    const int width = 320, height = 200;
+    std::vector<uint32_t> expectedPixels(width * height), actualPixels(width * height);
+    CFrameBuffer expected(expectedPixels.data(), width, height, width * sizeof(uint32_t));
+    CFrameBuffer actual(actualPixels.data(), width, height, width * sizeof(uint32_t));
+
+    auto scheduler = CTaskScheduler::Create(4);
+
+    // Windows that span several tiles, each one with a child
+    auto desktop = CDesktop::Create(TRect(0, 0, width - 1, height - 1));
+    std::vector<CWindowPtr> windows;
+    for (auto i = 0; i < 4; ++i) {
+        auto wnd = CWindow::Create(TRect(i * 70 + 5, i * 40 + 5, i * 70 + 104, i * 40 + 84));
+        auto child = CWindow::Create(TRect(10, 10, 69, 49));
+        wnd->SetColor(RGB(40 * i, 255 - 40 * i, 128));
+        child->SetColor(RGB(255 - 40 * i, 40 * i, 64));
+        wnd->SetBackingStore(true);
+        wnd->AddChild(child);
+        desktop->AddChild(wnd);
+        windows.push_back(wnd);
+    }
+
+    // Every window is refused a store, on each repaint
+    CBackingStore::SetLimitBytes(0);
+    for (auto i = 0; i < 3; ++i) {
+        windows[i]->SetColor(RGB(10 * i, 20 * i, 30 * i));
+        Check(RepaintMatches(*scheduler.get(), *desktop.get(), expected, actual), "tiled repaint without stores");
+    }
+    for (auto &wnd : windows) {
+        Check(!wnd->GetBackingStore(), "store refused");
+    }
+    Check(CBackingStore::GetUsedBytes() == 0, "no store memory used");
+
+    // Raising the limit gives the windows their stores on the next repaint
+    CBackingStore::SetLimitBytes(16 * 1024 * 1024);
+    for (auto i = 0; i < 3; ++i) {
+        windows[i]->GetChildren().front()->SetColor(RGB(30 * i, 20 * i, 10 * i));
+        Check(RepaintMatches(*scheduler.get(), *desktop.get(), expected, actual), "tiled repaint with stores");
+    }
+    for (auto &wnd : windows) {
+        Check(wnd->GetBackingStore() != nullptr, "store allocated");
+    }
+
+    if (s_failures) {
+        return 1;
+    }
+
+    printf("OK\n");
+    return 0;
+}